@@ -10,31 +10,34 @@
 #include "Alignment.h"
 #include <cassert>
 #include <sstream>
+#include <algorithm>
 
-AlignedHelix::AlignedHelix(const Helix & helix, int seqIndex, vector<int> & seq2AlignmentMap) {
+AlignedHelix::AlignedHelix(const Helix & helix, int seqIndex, vector<int> & seq2AlignmentMap) :
+		outer5(seq2AlignmentMap[helix.pos5]), outer3(seq2AlignmentMap[helix.pos3]), bpCount(helix.length), firstSeq(seqIndex){
 
 	int alignedPos5, alignedPos3;
 
-	for(int i = 0; i < helix.length; i++){
+	for(int i = 1; i < helix.length; i++){
 		alignedPos5 = seq2AlignmentMap[helix.pos5+i];
 		alignedPos3 = seq2AlignmentMap[helix.pos3-i];
 
-		bps.push_back(pair<int,int>(alignedPos5, alignedPos3));
+		if(alignedPos5 != outer5 + i || alignedPos3 != outer3 - i){
+			//gaps between the bps in the alignment: store the offset of every bp
+			offsets.resize(2 * helix.length, 0);
+			offsets[2*i] = alignedPos5 - (outer5 + i);
+			offsets[2*i + 1] = (outer3 - i) - alignedPos3;
+		}
 	}
-
-	appearsIn.insert(seqIndex);
 }
 
-AlignedHelix::AlignedHelix(int outerBpPos5, int outerBpPos3, int length){
+AlignedHelix::AlignedHelix(int outerBpPos5, int outerBpPos3, int length) :
+		outer5(outerBpPos5), outer3(outerBpPos3), bpCount(length), firstSeq(-1){
 	assert(outerBpPos5 >= 0);
+	assert(outerBpPos3 - (length - 1) > outerBpPos5 + (length - 1));
+}
 
-	int pos5, pos3;
-	for(int i = 0; i < length; i++){
-		pos5 = outerBpPos5 + i;
-		pos3 = outerBpPos3 - i;
-		assert(pos3 > pos5);
-		bps.push_back(pair<int,int>(pos5, pos3));
-	}
+
+AlignedHelix::AlignedHelix() : outer5(0), outer3(0), bpCount(0), firstSeq(-1){
 }
 
 
@@ -42,15 +45,55 @@ AlignedHelix::~AlignedHelix() {
 
 }
 
+pair<int, int> AlignedHelix::bp(int i) const{
+	if(offsets.empty()){
+		return pair<int, int>(outer5 + i, outer3 - i);
+	}
+	return pair<int, int>(outer5 + i + offsets[2*i], outer3 - i - offsets[2*i + 1]);
+}
+
+bool AlignedHelix::sameBps(const AlignedHelix & other) const{
+	return outer5 == other.outer5 && outer3 == other.outer3 && bpCount == other.bpCount && offsets == other.offsets;
+}
+
+void AlignedHelix::addSequence(int seqIndex){
+	if(firstSeq < 0){
+		firstSeq = seqIndex;
+	}
+	else if(seqIndex < firstSeq){
+		moreSeqs.insert(moreSeqs.begin(), firstSeq);
+		firstSeq = seqIndex;
+	}
+	else if(seqIndex > firstSeq){
+		vector<int>::iterator it = lower_bound(moreSeqs.begin(), moreSeqs.end(), seqIndex);
+		if(it == moreSeqs.end() || *it != seqIndex){
+			moreSeqs.insert(it, seqIndex);
+		}
+	}
+}
+
+int AlignedHelix::sequence(int k) const{
+	return (k == 0) ? firstSeq : moreSeqs[k - 1];
+}
+
+void AlignedHelix::swap(AlignedHelix & other){
+	std::swap(outer5, other.outer5);
+	std::swap(outer3, other.outer3);
+	std::swap(bpCount, other.bpCount);
+	offsets.swap(other.offsets);
+	std::swap(firstSeq, other.firstSeq);
+	moreSeqs.swap(other.moreSeqs);
+}
+
 string AlignedHelix::dotBracket(unsigned int alignmentLength){
 	string out = "";
 	for(unsigned int i = 0; i < alignmentLength; i++){
 		out += ".";
 	}
 
-	for(unsigned int i = 0; i < bps.size(); i++){
-		out[bps[i].first] = '(';
-		out[bps[i].second] = ')';
+	for(int i = 0; i < bpCount; i++){
+		out[bp(i).first] = '(';
+		out[bp(i).second] = ')';
 	}
 
 	return out;
@@ -60,7 +103,7 @@ bool AlignedHelix::insert(const Helix & helix, int seqIndex, vector<int> & seq2A
 	int alignedPos5, alignedPos3;
 
 	//has to match exactly, including size!
-	if(helix.length != (int)bps.size()){
+	if(helix.length != bpCount){
 		return false;
 	}
 
@@ -68,94 +111,117 @@ bool AlignedHelix::insert(const Helix & helix, int seqIndex, vector<int> & seq2A
 		alignedPos5 = seq2AlignmentMap[helix.pos5+i];
 		alignedPos3 = seq2AlignmentMap[helix.pos3-i];
 
-		if(alignedPos5 != bps[i].first || alignedPos3 != bps[i].second){
+		pair<int, int> alignedBp = bp(i);
+		if(alignedPos5 != alignedBp.first || alignedPos3 != alignedBp.second){
 			return false;
 		}
 	}
-	appearsIn.insert(seqIndex);
+	addSequence(seqIndex);
+	return true;
+}
+
+bool AlignedHelix::merge(const AlignedHelix & other){
+	if(!sameBps(other)){
+		return false;
+	}
+
+	for(int k = 0; k < other.appearances(); k++){
+		addSequence(other.sequence(k));
+	}
 	return true;
 }
 
 double AlignedHelix::logLikeRatio(Alignment & a, Tree & tree){
 	int pos3, pos5;
 	double loglike = 0;
-	for(vector<pair<int, int> >::iterator it = bps.begin(); it != bps.end(); it++){
-		pos5 = it->first;
-		pos3 = it->second;
+	for(int i = 0; i < bpCount; i++){
+		pos5 = bp(i).first;
+		pos3 = bp(i).second;
 		loglike += a.logLikelihood(pos5,pos3, tree);
 	}
-	return loglike / bps.size();
+	return loglike / bpCount;
 }
 
-double AlignedHelix::pairedLikelihood(Alignment & a, Tree & tree){
+void AlignedHelix::likelihoods(Alignment & a, Tree & tree, double & paired, double & unpaired, double & logLikeRatio){
 	int pos3, pos5;
-	double paired = 0;
-	for(vector<pair<int, int> >::iterator it = bps.begin(); it != bps.end(); it++){
-		pos5 = it->first;
-		pos3 = it->second;
-		paired += log(tree.calcFelsDouble(a, pos5, pos3))/log(2);
+	double pos5Single, pos3Single, bpPaired;
+	paired = 0;
+	unpaired = 0;
+	logLikeRatio = 0;
+	for(int i = 0; i < bpCount; i++){
+		pos5 = bp(i).first;
+		pos3 = bp(i).second;
+		bpPaired = a.logPairedLikelihood(pos5, pos3, tree);
+		pos5Single = a.logUnpairedLikelihood(pos5, tree);
+		pos3Single = a.logUnpairedLikelihood(pos3, tree);
+		paired += bpPaired;
+		unpaired += pos5Single;
+		unpaired += pos3Single;
+		logLikeRatio += bpPaired - pos5Single - pos3Single;
 	}
-	return paired / bps.size();
+	paired /= bpCount;
+	unpaired /= bpCount;
+	logLikeRatio /= bpCount;
+}
+
+double AlignedHelix::pairedLikelihood(Alignment & a, Tree & tree){
+	double paired, unpaired, ratio;
+	likelihoods(a, tree, paired, unpaired, ratio);
+	return paired;
 }
 double AlignedHelix::unpairdLikelihood(Alignment & a, Tree & tree){
-	int pos3, pos5;
-	double unpaired = 0;
-	for(vector<pair<int, int> >::iterator it = bps.begin(); it != bps.end(); it++){
-		pos5 = it->first;
-		pos3 = it->second;
-		unpaired += log(tree.calcFelsSingle(a, pos5))/log(2);
-		unpaired += log(tree.calcFelsSingle(a, pos3))/log(2);
-	}
-	return unpaired / bps.size();
+	double paired, unpaired, ratio;
+	likelihoods(a, tree, paired, unpaired, ratio);
+	return unpaired;
 }
 
 double AlignedHelix::canonicalBP(Alignment & a){
 	int pos3, pos5;
 	double canonicalBP = 0;
 
-	for(vector<pair<int, int> >::iterator it = bps.begin(); it != bps.end(); it++){
-		pos5 = it->first;
-		pos3 = it->second;
+	for(int i = 0; i < bpCount; i++){
+		pos5 = bp(i).first;
+		pos3 = bp(i).second;
 
 		canonicalBP += a.consensusBPPercent(pos5, pos3);
 	}
-	return canonicalBP / bps.size();
+	return canonicalBP / bpCount;
 }
 
 double AlignedHelix::covariance(Alignment & a){
 	int pos3, pos5;
 	double cov = 0;
 
-	for(vector<pair<int, int> >::iterator it = bps.begin(); it != bps.end(); it++){
-		pos5 = it->first;
-		pos3 = it->second;
+	for(int i = 0; i < bpCount; i++){
+		pos5 = bp(i).first;
+		pos3 = bp(i).second;
 
 		cov += a.getCovariance(pos5, pos3);
 	}
-	return cov / bps.size();
+	return cov / bpCount;
 }
 
 double AlignedHelix::conservation(Alignment & a){
 	int pos3, pos5;
 	double conserve = 0;
 
-	for(vector<pair<int, int> >::iterator it = bps.begin(); it != bps.end(); it++){
-		pos5 = it->first;
-		pos3 = it->second;
+	for(int i = 0; i < bpCount; i++){
+		pos5 = bp(i).first;
+		pos3 = bp(i).second;
 
 		conserve += a.getSeqCons(pos5);
 		conserve += a.getSeqCons(pos3);
 	}
-	return conserve / (2*bps.size());
+	return conserve / (2*bpCount);
 }
 
 bool AlignedHelix::isConsensusHelix(Alignment & a){
 	int pos3,pos5;
 
-	for(unsigned int i = 0; i < bps.size(); i++){
+	for(int i = 0; i < bpCount; i++){
 
-		pos5 = bps[i].first;
-		pos3 = bps[i].second;
+		pos5 = bp(i).first;
+		pos3 = bp(i).second;
 
 		if(a.alignedStruct[pos5] != pos3){
 			return false;
@@ -163,7 +229,7 @@ bool AlignedHelix::isConsensusHelix(Alignment & a){
 
 		if(a.alignedStruct[pos5 + 1] == pos3-1){
 			//bp inner to current bp is in consensus structure
-			if(!(i + 1 < bps.size()) || !(bps[i+1] == pair<int, int>(pos5+1, pos3-1))){
+			if(!(i + 1 < bpCount) || !(bp(i+1) == pair<int, int>(pos5+1, pos3-1))){
 				//bp inner to current bp not in this helix
 				return false;
 			}
@@ -171,7 +237,7 @@ bool AlignedHelix::isConsensusHelix(Alignment & a){
 
 		if((pos5 > 0 && pos3 + 1 < (int)a.alignedStruct.size()) && (a.alignedStruct[pos5 - 1] == pos3+1)){
 			//bp outer to current bp is in consensus structure
-			if(!(i > 0) || !(bps[i-1] == pair<int, int>(pos5-1, pos3+1))){
+			if(!(i > 0) || !(bp(i-1) == pair<int, int>(pos5-1, pos3+1))){
 				return false;
 			}
 		}
@@ -183,10 +249,10 @@ bool AlignedHelix::isConsensusHelix(Alignment & a){
 bool AlignedHelix::isPartialConsensusHelix(Alignment & a){
 	int pos3, pos5;
 
-	for(unsigned int i = 0; i < bps.size(); i++){
+	for(int i = 0; i < bpCount; i++){
 
-		pos5 = bps[i].first;
-		pos3 = bps[i].second;
+		pos5 = bp(i).first;
+		pos3 = bp(i).second;
 
 		if(a.alignedStruct[pos5] == pos3){
 			return true;
@@ -199,11 +265,12 @@ bool AlignedHelix::isPartialConsensusHelix(Alignment & a){
 bool AlignedHelix::isCompetingHelix(Alignment & a){
 	int pos3, pos5;
 
-	for(unsigned int i = 0; i < bps.size(); i++){
+	for(int i = 0; i < bpCount; i++){
 
-		for(set<int>::iterator seqIt = appearsIn.begin(); seqIt != appearsIn.end(); seqIt++){
-			pos5 = a.alignment2SeqMap[*seqIt]->at(bps[i].first);
-			pos3 = a.alignment2SeqMap[*seqIt]->at(bps[i].second);
+		for(int k = 0; k < appearances(); k++){
+			int seqIndex = sequence(k);
+			pos5 = a.alignment2SeqMap[seqIndex]->at(bp(i).first);
+			pos3 = a.alignment2SeqMap[seqIndex]->at(bp(i).second);
 
 			//sanity check: make sure that positions are not gaps in the sequence
 			assert(pos5>=0);
@@ -211,15 +278,15 @@ bool AlignedHelix::isCompetingHelix(Alignment & a){
 
 			//note: maybe I should check if helix is partial true helix?
 
-			if(a.seqStructs[*seqIt]->at(pos5) > 0 && a.seqStructs[*seqIt]->at(pos5) != pos3){
+			if(a.seqStructs[seqIndex]->at(pos5) > 0 && a.seqStructs[seqIndex]->at(pos5) != pos3){
 				//5' position competing
-				if(Utilities::iCheckLongHelix(*a.seqStructs[*seqIt], pos5)){
+				if(Utilities::iCheckLongHelix(*a.seqStructs[seqIndex], pos5)){
 					return true;
 				}
 			}
-			if(a.seqStructs[*seqIt]->at(pos3) > 0 && a.seqStructs[*seqIt]->at(pos3) != pos5){
+			if(a.seqStructs[seqIndex]->at(pos3) > 0 && a.seqStructs[seqIndex]->at(pos3) != pos5){
 				//3' position competing
-				if(Utilities::iCheckLongHelix(*a.seqStructs[*seqIt], pos3)){
+				if(Utilities::iCheckLongHelix(*a.seqStructs[seqIndex], pos3)){
 					return true;
 				}
 			}
@@ -234,10 +301,10 @@ bool AlignedHelix::isCompetingHelix(Alignment & a){
 int AlignedHelix::consensusBps(Alignment & a){
 	int pos3, pos5;
 	int consensusBpsCount = 0;
-	for(unsigned int i = 0; i < bps.size(); i++){
+	for(int i = 0; i < bpCount; i++){
 
-		pos5 = bps[i].first;
-		pos3 = bps[i].second;
+		pos5 = bp(i).first;
+		pos3 = bp(i).second;
 
 		if(a.alignedStruct[pos5] == pos3){
 			consensusBpsCount++;
@@ -249,34 +316,34 @@ int AlignedHelix::consensusBps(Alignment & a){
 
 double AlignedHelix::midpoint(){
 	int positionTotal = 0;
-	for(unsigned int i = 0; i < bps.size(); i++){
-		positionTotal += bps[i].first;
-		positionTotal += bps[i].second;
+	for(int i = 0; i < bpCount; i++){
+		positionTotal += bp(i).first;
+		positionTotal += bp(i).second;
 	}
 
-	return positionTotal / ((double) bps.size() * 2);
+	return positionTotal / ((double) bpCount * 2);
 }
 
 double AlignedHelix::midpoint(Alignment & a){
 	return midpoint() / a.alignedStruct.size();
 }
 
-int AlignedHelix::length(){
-	return bps.size();
+int AlignedHelix::length() const{
+	return bpCount;
 }
 
 
-int AlignedHelix::appearances(){
-	return appearsIn.size();
+int AlignedHelix::appearances() const{
+	return (firstSeq < 0) ? 0 : 1 + moreSeqs.size();
 }
 
-string AlignedHelix::bpsString(){
+string AlignedHelix::bpsString(long offset){
 	stringstream out;
-	unsigned int i;
-	for(i = 0; i < bps.size() - 1; i++){
-		out << bps[i].first << ":" << bps[i].second << ",";
+	int i;
+	for(i = 0; i < bpCount - 1; i++){
+		out << bp(i).first + offset << ":" << bp(i).second + offset << ",";
 	}
-	out << bps[i].first << ":" << bps[i].second;
+	out << bp(i).first + offset << ":" << bp(i).second + offset;
 	return out.str();
 }
 
@@ -296,12 +363,12 @@ pair<double,double> AlignedHelix::cisTransScore(Alignment & a){
 	double temp;
 	int L = a.alignedStruct.size();
 
-	for (unsigned int j = 0; j < bps.size(); j++){
+	for (int j = 0; j < bpCount; j++){
 
-		if(a.alignedStruct[bps[j].first] >= 0){
-			i_bar = a.alignedStruct[bps[j].first];
-			c = bps[j].second;
-			i = bps[j].first;
+		if(a.alignedStruct[bp(j).first] >= 0){
+			i_bar = a.alignedStruct[bp(j).first];
+			c = bp(j).second;
+			i = bp(j).first;
 			if(c != i_bar){
 				if(i_bar < i){
 					//3'-cis
@@ -322,10 +389,10 @@ pair<double,double> AlignedHelix::cisTransScore(Alignment & a){
 			}
 		}
 
-		if(a.alignedStruct[bps[j].second] >= 0){
-			i_bar = a.alignedStruct[bps[j].second];
-			c = bps[j].first;
-			i = bps[j].second;
+		if(a.alignedStruct[bp(j).second] >= 0){
+			i_bar = a.alignedStruct[bp(j).second];
+			c = bp(j).first;
+			i = bp(j).second;
 			if(c != i_bar){
 				if(i_bar > i){
 					//5'-cis
@@ -378,12 +445,12 @@ void AlignedHelix::competeScore(Alignment & a, double & cis5, double & cis3, dou
 	double temp;
 	int L = a.alignedStruct.size();
 
-	for (unsigned int j = 0; j < bps.size(); j++){
+	for (int j = 0; j < bpCount; j++){
 
-		if(a.alignedStruct[bps[j].first] >= 0){
-			i_bar = a.alignedStruct[bps[j].first];
-			c = bps[j].second;
-			i = bps[j].first;
+		if(a.alignedStruct[bp(j).first] >= 0){
+			i_bar = a.alignedStruct[bp(j).first];
+			c = bp(j).second;
+			i = bp(j).first;
 			if(c != i_bar){
 				if(i_bar < i){
 					//3'-cis
@@ -410,10 +477,10 @@ void AlignedHelix::competeScore(Alignment & a, double & cis5, double & cis3, dou
 			}
 		}
 
-		if(a.alignedStruct[bps[j].second] >= 0){
-			i_bar = a.alignedStruct[bps[j].second];
-			c = bps[j].first;
-			i = bps[j].second;
+		if(a.alignedStruct[bp(j).second] >= 0){
+			i_bar = a.alignedStruct[bp(j).second];
+			c = bp(j).first;
+			i = bp(j).second;
 			if(c != i_bar){
 				if(i_bar > i){
 					//5'-cis
@@ -9,7 +9,6 @@
 #define ALIGNEDHELIX_H_
 
 #include <vector>
-#include <set>
 #include <string>
 #include "Helix.h"
 #include "Tree.h"
@@ -22,6 +21,11 @@ class AlignedHelix {
 public:
 	AlignedHelix(const Helix & helix, int seqIndex, vector<int> & seq2AlignmentMap);
 	AlignedHelix(int outerBpPos5, int outerBpPos3, int length);
+
+	/**
+	 * a helix without bps, to swap another one into
+	 */
+	AlignedHelix();
 	virtual ~AlignedHelix();
 
 	string dotBracket(unsigned int alignmentLength);
@@ -32,6 +36,14 @@ public:
 	double pairedLikelihood(Alignment & a, Tree & t);
 	double unpairdLikelihood(Alignment & a, Tree & t);
 	double logLikeRatio(Alignment & a, Tree & t);
+
+	/**
+	 * sets the mean paired and unpaired log likelihoods of the bps, and their log likelihood
+	 * ratio, in one pass. Likelihoods are looked up in (or added to) the tables of a, so
+	 * each column pair is only calculated once
+	 */
+	void likelihoods(Alignment & a, Tree & t, double & paired, double & unpaired, double & logLikeRatio);
+
 	double canonicalBP(Alignment & a);
 	double covariance(Alignment & a);
 	double conservation(Alignment & a);
@@ -45,6 +57,13 @@ public:
 	 */
 	bool insert(const Helix & helix, int seqIndex, vector<int> & seq2AlignmentMap);
 
+	/**
+	 * tries to merge the given aligned helix (found in other sequences)
+	 * If it has exactly the same bps as this helix, add the sequences in which it appears
+	 * and return true. If not, do nothing and return false.
+	 */
+	bool merge(const AlignedHelix & other);
+
 	/**
 	 * returns true if helix is found in alignment consensus structure, else false
 	 *
@@ -101,55 +120,77 @@ public:
 	/**
 	 * returns the number of bps in the helix
 	 */
-	int length();
+	int length() const;
+
+	/**
+	 * returns the i-th bp of the helix, counted from the outside in: 5' and 3' position
+	 * with respect to the alignment
+	 */
+	pair<int, int> bp(int i) const;
+
+	/**
+	 * true if other has exactly the same bps
+	 */
+	bool sameBps(const AlignedHelix & other) const;
 
 	/**
 	 * returns the number of sequences in which this exact helix appears
 	 * note: this does not count sub- or supersets of the helix
 	 */
-	int appearances();
+	int appearances() const;
 
 	/**
-	 * returns a string with the positions of the bps, separated by commas
+	 * returns the alignment index of the k-th sequence in which this helix appears
+	 * (0 <= k < appearances(); in increasing order)
+	 */
+	int sequence(int k) const;
+
+	/**
+	 * exchanges the contents of this helix and other, without copying
+	 */
+	void swap(AlignedHelix & other);
+
+	/**
+	 * returns a string with the positions of the bps (plus offset), separated by commas
 	 * example:
 	 * 12:32,11:31,10:29
 	 */
-	string bpsString();
+	string bpsString(long offset = 0);
 
 	pair<double,double> cisTransScore(Alignment & a);
 
 	void competeScore(Alignment & a, double & cis5, double & cis3, double & trans5, double & trans3, double & mid5, double & mid3);
 	//double trans(Alignment & a);
 
-	/**
-	 * vector containing pairs of integers representing the position of each bp of the helix.
-	 * First in pair is 5' position
-	 * Second in pair is 3' position
-	 * Positions are with respect to the alignment.
-	 * Bps in this vector are ordered outer to inner.
-	 *
-	 */
-	vector<pair<int, int> > bps; //could be a linked list instead... not sure it would make a difference
-
-
 private:
 	//TODO: this class should probably store a pointer to
 	//the alignment in which it exists in, so that the methods
 	//don't need to take as parameters the alignment
 
-
 	/**
-	 * set containing the alignment indexes of the sequences in which this helix appears
+	 * the outer bp (5' and 3' position with respect to the alignment) and the number of bps.
+	 * Without gaps in the alignment, bp i is outer5 + i, outer3 - i.
 	 */
-	set<int> appearsIn;
+	int outer5;
+	int outer3;
+	int bpCount;
 
 	/**
-	 * list of consensus helices that this aligned helix competes with
+	 * if the helix has gaps between its bps in the alignment: for each bp i, how many columns
+	 * further in its 5' position (offsets[2*i]) and 3' position (offsets[2*i+1]) are than
+	 * they would be without gaps. Empty if there are no gaps (the usual case)
 	 */
-	list<AlignedHelix*> competesWith;
-
+	vector<int> offsets;
 
+	/**
+	 * alignment indexes of the sequences in which this helix appears, in increasing order:
+	 * the first (-1 if none), and the rest. Most helices appear in one sequence only, which
+	 * then takes no extra space
+	 */
+	int firstSeq;
+	vector<int> moreSeqs;
 
+	void addSequence(int seqIndex);
 };
 
 #endif /* ALIGNEDHELIX_H_ */
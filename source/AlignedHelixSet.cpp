@@ -0,0 +1,102 @@
+/*
+ * Copyright: Nicholas P Wiebe (2008-2009) and Irmtraud M Meyer (2008-2009)
+ * License: licensed under the GNU General Public License version 3 (GPLv3)
+ */
+
+#include "AlignedHelixSet.h"
+#include <algorithm>
+
+/**
+ * orders indices of helices by outer base pair of the helix
+ */
+struct OuterBpLess {
+	const vector<AlignedHelix> & helices;
+	OuterBpLess(const vector<AlignedHelix> & helices) : helices(helices) {}
+	bool operator()(int a, int b) const {
+		return helices[a].bp(0) < helices[b].bp(0);
+	}
+};
+
+AlignedHelixSet::AlignedHelixSet() {
+}
+
+AlignedHelixSet::~AlignedHelixSet() {
+}
+
+size_t AlignedHelixSet::hash(const Helix & h, vector<int> & seq2AlignmentMap){
+	//FNV-1a over length and aligned positions
+	size_t key = 2166136261u;
+	key = (key ^ h.length) * 16777619u;
+	for(int i = 0; i < h.length; i++){
+		key = (key ^ seq2AlignmentMap[h.pos5 + i]) * 16777619u;
+		key = (key ^ seq2AlignmentMap[h.pos3 - i]) * 16777619u;
+	}
+	return key;
+}
+
+size_t AlignedHelixSet::hash(const AlignedHelix & h){
+	size_t key = 2166136261u;
+	key = (key ^ h.length()) * 16777619u;
+	for(int i = 0; i < h.length(); i++){
+		pair<int, int> bp = h.bp(i);
+		key = (key ^ bp.first) * 16777619u;
+		key = (key ^ bp.second) * 16777619u;
+	}
+	return key;
+}
+
+void AlignedHelixSet::add(const Helix & h, int seqIndex, vector<int> & seq2AlignmentMap){
+	int & first = index.insert(make_pair(hash(h, seq2AlignmentMap), -1)).first->second;
+
+	//try to insert it into existing helices
+	for(int i = first; i >= 0; i = nextWithHash[i]){
+		if(helices[i].insert(h, seqIndex, seq2AlignmentMap)){
+			return;
+		}
+	}
+
+	//not found -> create new AlignedHelix and add it in, at the head of its chain
+	nextWithHash.push_back(first);
+	first = helices.size();
+	helices.push_back(AlignedHelix(h, seqIndex, seq2AlignmentMap));
+}
+
+void AlignedHelixSet::merge(const AlignedHelixSet & other){
+	for(unsigned int j = 0; j < other.helices.size(); j++){
+		int & first = index.insert(make_pair(hash(other.helices[j]), -1)).first->second;
+
+		bool found = false;
+		for(int i = first; i >= 0 && !found; i = nextWithHash[i]){
+			found = helices[i].merge(other.helices[j]);
+		}
+
+		if(!found){
+			nextWithHash.push_back(first);
+			first = helices.size();
+			helices.push_back(other.helices[j]);
+		}
+	}
+}
+
+void AlignedHelixSet::takeSortedHelices(vector<AlignedHelix> & out){
+	//sort indices rather than the helices themselves, and move rather than copy them
+	vector<int> order(helices.size());
+	for(unsigned int i = 0; i < order.size(); i++){
+		order[i] = i;
+	}
+	stable_sort(order.begin(), order.end(), OuterBpLess(helices));
+
+	unsigned int start = out.size();
+	out.resize(start + order.size());
+	for(unsigned int i = 0; i < order.size(); i++){
+		out[start + i].swap(helices[order[i]]);
+	}
+
+	helices.clear();
+	index.clear();
+	nextWithHash.clear();
+}
+
+int AlignedHelixSet::size() const{
+	return helices.size();
+}
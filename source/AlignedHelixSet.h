@@ -0,0 +1,65 @@
+/*
+ * Copyright: Nicholas P Wiebe (2008-2009) and Irmtraud M Meyer (2008-2009)
+ * License: licensed under the GNU General Public License version 3 (GPLv3)
+ * AlignedHelixSet.h
+ *
+ * The distinct AlignedHelices of an alignment, collected from the helices of its
+ * sequences. Helices of different sequences that align to exactly the same base pairs
+ * are stored once, with all the sequences they appear in. Only helices actually found
+ * take up space: they are looked up through a hash of their aligned base pairs.
+ */
+
+#ifndef ALIGNEDHELIXSET_H_
+#define ALIGNEDHELIXSET_H_
+
+#include <vector>
+#include <tr1/unordered_map>
+#include "AlignedHelix.h"
+#include "Helix.h"
+
+using namespace std;
+
+class AlignedHelixSet {
+public:
+	AlignedHelixSet();
+	virtual ~AlignedHelixSet();
+
+	/**
+	 * adds helix h of sequence seqIndex: to the AlignedHelix with the same aligned base pairs
+	 * if there is one, else as a new AlignedHelix
+	 */
+	void add(const Helix & h, int seqIndex, vector<int> & seq2AlignmentMap);
+
+	/**
+	 * adds the helices of other, in the order other found them, as if its sequences had been
+	 * added to this set after the sequences already in it
+	 */
+	void merge(const AlignedHelixSet & other);
+
+	/**
+	 * moves the helices to the end of out, ordered by outer base pair (5' position, then 3'
+	 * position); helices with the same outer base pair in the order they were first found.
+	 * The set is empty afterwards
+	 */
+	void takeSortedHelices(vector<AlignedHelix> & out);
+
+	int size() const;
+
+private:
+	vector<AlignedHelix> helices;
+
+	/**
+	 * hash of the aligned base pairs -> index in helices of the last helix added with that
+	 * hash. The others with the same hash are chained through nextWithHash (-1 ends a chain)
+	 */
+	tr1::unordered_map<size_t, int> index;
+	vector<int> nextWithHash;
+
+	/**
+	 * hash of the aligned base pairs of a helix; both versions give the same hash for the same bps
+	 */
+	static size_t hash(const Helix & h, vector<int> & seq2AlignmentMap);
+	static size_t hash(const AlignedHelix & h);
+};
+
+#endif /* ALIGNEDHELIXSET_H_ */
@@ -17,7 +17,10 @@
 #include <cstdlib>
 #include <ctime>
 #include <cstring>
+#include <climits>
 #include "ShuffledAlignment.h"
+#include "StemFinder.h"
+#include "ColumnProfiles.h"
 
 string Alignment::TEMP_FASTA_FILENAME = "temp.fasta";
 string Alignment::TEMP_OUTPUT_FASTA_FILENAME = "temp.out.fasta";
@@ -29,12 +32,13 @@ string Alignment::JAVA_LOC = "java";
 
 
 int Alignment::minStemLength = 8;
+int Alignment::maxSpan = INT_MAX;
 bool Alignment::printHeaders = true;
 
 Alignment::Alignment() {
-	consensusBP = NULL;
-	gapFraction = NULL;
-	seqCons = NULL;
+	profiles = NULL;
+	compiled = NULL;
+	sharedLikelihoods = NULL;
 
 }
 
@@ -87,9 +91,9 @@ Alignment::Alignment(vector<string> & names, vector<string> & alignment, vector<
 	labelHelices2();
 	initializeStatsMatrix();
 
-	consensusBP = NULL;
-	gapFraction = NULL;
-	seqCons = NULL;
+	profiles = NULL;
+	compiled = NULL;
+	sharedLikelihoods = NULL;
 }
 
 Alignment::Alignment(string& filename) {
@@ -97,9 +101,9 @@ Alignment::Alignment(string& filename) {
 	labelHelices2();
 	initializeStatsMatrix();
 
-	consensusBP = NULL;
-	gapFraction = NULL;
-	seqCons = NULL;
+	profiles = NULL;
+	compiled = NULL;
+	sharedLikelihoods = NULL;
 
 }
 
@@ -116,9 +120,9 @@ Alignment::Alignment(string & filename, string & structFilename)
 	labelHelices2();
 	initializeStatsMatrix();
 
-	consensusBP = NULL;
-	gapFraction = NULL;
-	seqCons = NULL;
+	profiles = NULL;
+	compiled = NULL;
+	sharedLikelihoods = NULL;
 }
 
 void Alignment::initializeStatsMatrix()
@@ -147,13 +151,14 @@ void Alignment::initializeStatsMatrix()
 	}
 	competingHelices.clear();
 
-	//delete vector<vector<double>* > FelsDoubles
-	for(unsigned int i = 0; i < felsDoubles.size(); i++){
-		delete felsDoubles[i];
-	}
-	felsDoubles.clear();
 	felsSingles.clear();
 
+	//stems are searched for on first use
+	clearStems();
+	stemCache.assign(seqs.size(), NULL);
+	stemCacheSettings.assign(seqs.size(), pair<int, int>(0, 0));
+	stemOrder.assign(seqs.size(), vector<int>());
+
 	//initialize stats matrix
 	vector<vector<StatsWrapper*>* >* temp;
 	for (unsigned int i = 0; i < seqs.size(); i++){
@@ -167,16 +172,36 @@ void Alignment::initializeStatsMatrix()
 		competingHelices.push_back(new vector<CompetingHelix*>());
 	}
 
-	//initialize log likelihood tables:
-	for(unsigned int i = 0; i < alignedStruct.size(); i++){
-		felsSingles.push_back(1);
-		vector<double> * temp_vec = new vector<double>();
-		//should be an upper-triangular matrix, but isn't currently
-		for(unsigned int j = 0; j < alignedStruct.size(); j++){
-			temp_vec->push_back(1);
+	//initialize log likelihood tables (one entry per column pattern):
+	compressColumns();
+	felsSingles.assign(patternCount, 1);
+	//square: the 5' column of a pair can have any pattern. Allocated as pairs are calculated
+	felsDoubles.reset(patternCount, 1);
+}
+
+void Alignment::compressColumns(){
+	if(columnPatterns.size() == alignedStruct.size()){
+		return; //already known
+	}
+
+	columnPatterns.clear();
+	map<string, int> patterns;
+	string column(alignedSeqs.size(), ' ');
+	for(unsigned int j = 0; j < alignedStruct.size(); j++){
+		for(unsigned int i = 0; i < alignedSeqs.size(); i++){
+			column[i] = (*alignedSeqs[i])[j];
+		}
+		map<string, int>::iterator it = patterns.find(column);
+		if(it == patterns.end()){
+			int pattern = patterns.size();
+			patterns[column] = pattern;
+			columnPatterns.push_back(pattern);
+		}
+		else{
+			columnPatterns.push_back(it->second);
 		}
-		felsDoubles.push_back(temp_vec);
 	}
+	patternCount = patterns.size();
 }
 
 
@@ -262,21 +287,59 @@ void Alignment::clearAll(){
 	}
 	trueHelices.clear();
 
-	//delete vector<vector<double>* > FelsDoubles
-	for(unsigned int i = 0; i < felsDoubles.size(); i++){
-		delete felsDoubles[i];
-	}
-	felsDoubles.clear();
+	felsDoubles.reset(0, 1);
 
-	delete consensusBP;
-	consensusBP = NULL;
+	delete profiles;
+	profiles = NULL;
 
-	delete gapFraction;
-	gapFraction = NULL;
+	delete compiled;
+	compiled = NULL;
 
-	delete seqCons;
-	seqCons = NULL;
+	columnPatterns.clear();
+	patternCount = 0;
 
+	clearStems();
+}
+
+void Alignment::clearStems(){
+	for(unsigned int i = 0; i < stemCache.size(); i++){
+		delete stemCache[i];
+	}
+	stemCache.clear();
+	stemCacheSettings.clear();
+	stemOrder.clear();
+}
+
+/**
+ * orders indices of stems by the outer 3' position of the stems, then from the inside out
+ */
+struct GStatsOrder {
+	const vector<Helix> & stems;
+	GStatsOrder(const vector<Helix> & stems_) : stems(stems_) {}
+	bool operator()(int a, int b) const{
+		if(stems[a].pos3 != stems[b].pos3){
+			return stems[a].pos3 < stems[b].pos3;
+		}
+		return stems[a].pos5 > stems[b].pos5;
+	}
+};
+
+const vector<Helix> & Alignment::sequenceStems(int seqIndex){
+	pair<int, int> settings(minStemLength, maxSpan);
+	if(stemCache[seqIndex] == NULL || stemCacheSettings[seqIndex] != settings){
+		delete stemCache[seqIndex];
+		stemCache[seqIndex] = new vector<Helix>();
+		StemFinder(*seqs[seqIndex]).findStems(minStemLength, *stemCache[seqIndex], maxSpan);
+		stemCacheSettings[seqIndex] = settings;
+
+		vector<int> & order = stemOrder[seqIndex];
+		order.resize(stemCache[seqIndex]->size());
+		for(unsigned int s = 0; s < order.size(); s++){
+			order[s] = s;
+		}
+		sort(order.begin(), order.end(), GStatsOrder(*stemCache[seqIndex]));
+	}
+	return *stemCache[seqIndex];
 }
 
 Alignment::~Alignment() {
@@ -455,9 +518,9 @@ double Alignment::seqConservationAtPosition(int i)
 			//if position is gap, add one to every letter
 		//since we are more interested in low conservation regions
 		//this is more a more conservative approach
-		vector<int> increment = Utilities::interpret(base);
+		int increment = Utilities::interpretMask(base);
 		for (int j = 0; j< 4; j++){
-			baseCounts[j] += increment[j];
+			baseCounts[j] += (increment >> j) & 1;
 		}
 
 
@@ -1376,14 +1439,13 @@ void Alignment::alignmentGStats(const double eStack[4][4][4][4])
 
 void Alignment::sequenceGStats(const double eStack[4][4][4][4], const int seqIndex)
 {
-	int **DP;
 	int i, j, k, i_2, j_2;
 	double eE;
 
-	string Seq = *(seqs[seqIndex]);
+	const string & Seq = *(seqs[seqIndex]);
 	int iL = Seq.length();
 
-	vector<int> P = *(seqStructs[seqIndex]);
+	vector<int> & P = *(seqStructs[seqIndex]);
 	// Initialize values
 
 	//info needed to store competing helices
@@ -1405,146 +1467,124 @@ void Alignment::sequenceGStats(const double eStack[4][4][4][4], const int seqInd
 	}
 	competingHelices[seqIndex]->clear();
 
-	// allocate and initialize memory for dynamic programming
+	// competing helices come from the stems of the sequence, in order of their outer 3'
+	// position, then from the inside out. Stems that reach either end of the sequence are
+	// not used. i-j is the pair just outside the stem, and inner its length
 
-	DP = (int**) malloc(sizeof(int*) * iL);
-	for (i = 0; i < iL; i++) {
-		DP[i] = (int*) malloc(sizeof(int) * iL);
-	}
+	const vector<Helix> & stems = sequenceStems(seqIndex);
+	const vector<int> & order = stemOrder[seqIndex];
 
-	for (i = 0; i < iL; i++) {
-		for (j = 0; j < iL; j++) {
-			DP[i][j] = 0;
+	for (unsigned int s = 0; s < order.size(); s++) {
+		const Helix & stem = stems[order[s]];
+		if (stem.pos5 == 0 || stem.pos3 == iL - 1) {
+			continue;
 		}
-	}
+		i = stem.pos5 - 1;
+		j = stem.pos3 + 1;
+		int inner = stem.length;
 
-	// dynamic programming
+		if(isHelixCompeting(seqIndex, i+1, j-1, inner)){
+			//have a competing helix!
+			//cout << "competing helix found\n";
+			start5 = i + 1;
+			end3 = j - 1;
 
-	for (j = MIN_DIST; j < iL; j++) {
-		for (i = j - MIN_DIST; i >= 0; i--) {
-
-			assert(i>= 0 && i < iL-MIN_DIST+1);
-
-			if ((Seq[i] == 'A' && Seq[j] == 'U') || (Seq[i] == 'U' && Seq[j] == 'A') || (Seq[i] == 'C' && Seq[j] == 'G') || (Seq[i] == 'G' && Seq[j] == 'C') || (Seq[i] == 'G' && Seq[j] == 'U') || (Seq[i] == 'U' && Seq[j] == 'G')) {
-				assert(i+1 < iL-MIN_DIST+1);
-				DP[i][j] = DP[i + 1][j - 1] + 1;
-			} else {
-				DP[i][j] = 0;
+			//add a row of StatsWrappers to the StatsMatrix for sequence seqIndex
+			for(unsigned int index = 0; index < StatsMatrix[seqIndex]->size(); index++){
+				StatsMatrix[seqIndex]->at(index)->push_back(new StatsWrapper());
 			}
 
-			if ((DP[i][j] == 0) && (DP[i + 1][j - 1] > minStemLength)) {
-				// iterating on one found helix
+			eE = 0.0;
 
+			for (k = 0; k < inner - 1; k++) {
 
-				if(isHelixCompeting(seqIndex, i+1, j-1, DP[i+1][j-1])){
-					//have a competing helix!
-					//cout << "competing helix found\n";
-					start5 = i + 1;
-					end3 = j - 1;
+				i_2 = i + 1 + k;
+				j_2 = j - 1 - k;
 
-					//add a row of StatsWrappers to the StatsMatrix for sequence seqIndex
-					for(unsigned int index = 0; index < StatsMatrix[seqIndex]->size(); index++){
-						StatsMatrix[seqIndex]->at(index)->push_back(new StatsWrapper());
-					}
-
-					eE = 0.0;
-
-					for (k = 0; k < DP[i + 1][j - 1] - 1; k++) {
-
-						i_2 = i + 1 + k;
-						j_2 = j - 1 - k;
-
-						eE += eStack[Utilities::iAt(Seq[i_2])][Utilities::iAt(Seq[i_2 + 1])][Utilities::iAt(Seq[j_2 - 1])][Utilities::iAt(Seq[j_2])];
-					}
-					//cout << "eE: " << eE << endl;
-					//instead, calculate p stats ----
-					//eE = 1;
-					//-------------------------------
-					for (k = 0; k < DP[i + 1][j - 1]; k++) {
+				eE += eStack[Utilities::iAt(Seq[i_2])][Utilities::iAt(Seq[i_2 + 1])][Utilities::iAt(Seq[j_2 - 1])][Utilities::iAt(Seq[j_2])];
+			}
+			//cout << "eE: " << eE << endl;
+			//instead, calculate p stats ----
+			//eE = 1;
+			//-------------------------------
+			for (k = 0; k < inner; k++) {
 
-						i_2 = i + 1 + k;
-						j_2 = j - 1 - k;
+				i_2 = i + 1 + k;
+				j_2 = j - 1 - k;
 
-						// if i paired
+				// if i paired
 
-						if ((P[i_2] != -1) && (Utilities::iCheckLongHelix(P, i_2) == 1)) {
+				if ((P[i_2] != -1) && (Utilities::iCheckLongHelix(P, i_2) == 1)) {
 
 
-							helixIndex = helixLabels[seqIndex]->at(i_2);
+					helixIndex = helixLabels[seqIndex]->at(i_2);
 
-							if (P[i_2] < i_2) { // (p,i,j) --> (i^, i, c) 3'cis
+					if (P[i_2] < i_2) { // (p,i,j) --> (i^, i, c) 3'cis
 
-								double statvalue = -(eE) / ((double) (j - 2 - 2 * k - i) * log((double) (iL - i_2)));
+						double statvalue = -(eE) / ((double) (j - 2 - 2 * k - i) * log((double) (iL - i_2)));
 
-								StatsMatrix[seqIndex]->at(helixIndex)->back()->eStats[0] += statvalue;
-								StatsMatrix[seqIndex]->at(helixIndex)->back()->iStats[0]++;
+						StatsMatrix[seqIndex]->at(helixIndex)->back()->eStats[0] += statvalue;
+						StatsMatrix[seqIndex]->at(helixIndex)->back()->iStats[0]++;
 
-							}
-							else if ((P[i_2] > i_2) && (P[i_2] < j_2)) { // (i,p,j) --> (i, i^, c) 3'trans
+					}
+					else if ((P[i_2] > i_2) && (P[i_2] < j_2)) { // (i,p,j) --> (i, i^, c) 3'trans
 
-								double statvalue = -(eE) / ((double) (j_2 - P[i_2]) * log((double) (iL - P[i_2])));
+						double statvalue = -(eE) / ((double) (j_2 - P[i_2]) * log((double) (iL - P[i_2])));
 
-								StatsMatrix[seqIndex]->at(helixIndex)->back()->eStats[1] += statvalue;
-								StatsMatrix[seqIndex]->at(helixIndex)->back()->iStats[1]++;
+						StatsMatrix[seqIndex]->at(helixIndex)->back()->eStats[1] += statvalue;
+						StatsMatrix[seqIndex]->at(helixIndex)->back()->iStats[1]++;
 
-							}
-							else if (P[i_2] > j_2) { // (i,j,p) --> (i, c, i^) 3' mid
+					}
+					else if (P[i_2] > j_2) { // (i,j,p) --> (i, c, i^) 3' mid
 
-								double statvalue = -(eE) / ((double) (j - 2 - 2 * k - i)
-										* log((double) (P[i_2] - i_2)));
-								StatsMatrix[seqIndex]->at(helixIndex)->back()->eStats[2] += statvalue;
-								StatsMatrix[seqIndex]->at(helixIndex)->back()->iStats[2]++;
-							}
-						}
+						double statvalue = -(eE) / ((double) (j - 2 - 2 * k - i)
+								* log((double) (P[i_2] - i_2)));
+						StatsMatrix[seqIndex]->at(helixIndex)->back()->eStats[2] += statvalue;
+						StatsMatrix[seqIndex]->at(helixIndex)->back()->iStats[2]++;
+					}
+				}
 
-						// if j paired
+				// if j paired
 
-						if ((P[j_2] != -1) && (Utilities::iCheckLongHelix(P, j_2) == 1)) {
+				if ((P[j_2] != -1) && (Utilities::iCheckLongHelix(P, j_2) == 1)) {
 
-							//get helix label of true helix that is being competed
-							helixIndex = helixLabels[seqIndex]->at(j_2);
+					//get helix label of true helix that is being competed
+					helixIndex = helixLabels[seqIndex]->at(j_2);
 
-							if (P[j_2] > j_2) { //(i,j,p) --> (c, i, i^) 5'cis
+					if (P[j_2] > j_2) { //(i,j,p) --> (c, i, i^) 5'cis
 
-								double statvalue = -(eE) / ((double) (j - 2 - 2 * k
-										- i) * log((double) (j_2)));
+						double statvalue = -(eE) / ((double) (j - 2 - 2 * k
+								- i) * log((double) (j_2)));
 
-								StatsMatrix[seqIndex]->at(helixIndex)->back()->revEStats[0] += statvalue;
-								StatsMatrix[seqIndex]->at(helixIndex)->back()->revIStats[0]++;
+						StatsMatrix[seqIndex]->at(helixIndex)->back()->revEStats[0] += statvalue;
+						StatsMatrix[seqIndex]->at(helixIndex)->back()->revIStats[0]++;
 
-							}
-							else if ((P[j_2] > i_2) && (P[j_2] < j_2)) { //(i,p,j) --> (c, i^, i) 5'trans
+					}
+					else if ((P[j_2] > i_2) && (P[j_2] < j_2)) { //(i,p,j) --> (c, i^, i) 5'trans
 
-								double statvalue = -(eE) / ((double) (P[j_2] - i_2) * log((double) (P[j_2])));
-								StatsMatrix[seqIndex]->at(helixIndex)->back()->revEStats[1] += statvalue;
-								StatsMatrix[seqIndex]->at(helixIndex)->back()->revIStats[1]++;
-							}
-							else if (P[j_2] < i_2) { //(p, i, j) --> (i^, c, i) 5' mid
-								double statvalue = -(eE) / ((double) (i_2 - P[j_2]) * log((double) (j_2 - P[j_2])));
-								StatsMatrix[seqIndex]->at(helixIndex)->back()->revEStats[2] += statvalue;
-								StatsMatrix[seqIndex]->at(helixIndex)->back()->revIStats[2]++;
-							}
-						}
+						double statvalue = -(eE) / ((double) (P[j_2] - i_2) * log((double) (P[j_2])));
+						StatsMatrix[seqIndex]->at(helixIndex)->back()->revEStats[1] += statvalue;
+						StatsMatrix[seqIndex]->at(helixIndex)->back()->revIStats[1]++;
+					}
+					else if (P[j_2] < i_2) { //(p, i, j) --> (i^, c, i) 5' mid
+						double statvalue = -(eE) / ((double) (i_2 - P[j_2]) * log((double) (j_2 - P[j_2])));
+						StatsMatrix[seqIndex]->at(helixIndex)->back()->revEStats[2] += statvalue;
+						StatsMatrix[seqIndex]->at(helixIndex)->back()->revIStats[2]++;
 					}
+				}
+			}
 
-					end5 = i + 1 + k - 1;
-					start3 = j - 1 - k + 1;
+			end5 = i + 1 + k - 1;
+			start3 = j - 1 - k + 1;
 
-					currentCompetingHelix = new CompetingHelix(start5, end5, start3, end3);
-					competingHelices[seqIndex]->push_back(currentCompetingHelix);
+			currentCompetingHelix = new CompetingHelix(start5, end5, start3, end3);
+			competingHelices[seqIndex]->push_back(currentCompetingHelix);
 
-				}//if (isHelixCompeting)
-				//if helix is not competing, ignore it
-			}
-		}
+		}//if (isHelixCompeting)
+		//if helix is not competing, ignore it
 	}
 
 
-	for (i = 0; i < iL; i++) {
-		free(DP[i]);
-	}
-	free(DP);
-
 	return;
 }
 
@@ -2077,9 +2117,9 @@ void Alignment::printCoreLogLikelihoods(Tree & treeRoot){
 				int pos5 = cores[i]->at(j)->getPos5();
 				int pos3 = cores[i]->at(j)->getPos3();
 				for (int k = 0; k < cores[i]->at(j)->getLength(); k++){
-					pairedLogLike += log(treeRoot.calcFelsDouble(*this, pos5+k, pos3-k))/log(2);
-					singleLogLike += log(treeRoot.calcFelsSingle(*this, pos5+k))/log(2);
-					singleLogLike += log(treeRoot.calcFelsSingle(*this, pos3-k))/log(2);
+					pairedLogLike += treeRoot.logFelsDouble(*this, pos5+k, pos3-k, felsWorkspace);
+					singleLogLike += treeRoot.logFelsSingle(*this, pos5+k, felsWorkspace);
+					singleLogLike += treeRoot.logFelsSingle(*this, pos3-k, felsWorkspace);
 					if(alignedStruct[pos5+k] != -1){
 						if(alignedStruct[pos5+k] > pos5+k){
 							is3trans++;
@@ -2123,9 +2163,9 @@ void Alignment::printTrueHelixLogLikelihoods(Tree & treeRoot){
 		int pos5 = trueHelices[i]->pos5;
 		int pos3 = trueHelices[i]->pos3;
 		for (int k = 0; k < trueHelices[i]->length; k++){
-			pairedLogLike += log(treeRoot.calcFelsDouble(*this, pos5+k, pos3-k))/log(2);
-			singleLogLike += log(treeRoot.calcFelsSingle(*this, pos5+k))/log(2);
-			singleLogLike += log(treeRoot.calcFelsSingle(*this, pos3-k))/log(2);
+			pairedLogLike += treeRoot.logFelsDouble(*this, pos5+k, pos3-k, felsWorkspace);
+			singleLogLike += treeRoot.logFelsSingle(*this, pos5+k, felsWorkspace);
+			singleLogLike += treeRoot.logFelsSingle(*this, pos3-k, felsWorkspace);
 		}
 
 		double logRatio = (pairedLogLike - singleLogLike) / trueHelices[i]->length;
@@ -2169,9 +2209,9 @@ void Alignment::printCompetingHelixLogLikelihoods(Tree & treeRoot){
 				for (int k = 0; k < length; k++){
 					int alignedPos5 = seq2AlignmentMap[i]->at(pos5+k);
 					int alignedPos3 = seq2AlignmentMap[i]->at(pos3-k);
-					pairedLogLike += log(treeRoot.calcFelsDouble(*this, alignedPos5 , alignedPos3))/log(2);
-					singleLogLike += log(treeRoot.calcFelsSingle(*this, alignedPos5))/log(2);
-					singleLogLike += log(treeRoot.calcFelsSingle(*this, alignedPos3))/log(2);
+					pairedLogLike += treeRoot.logFelsDouble(*this, alignedPos5 , alignedPos3, felsWorkspace);
+					singleLogLike += treeRoot.logFelsSingle(*this, alignedPos5, felsWorkspace);
+					singleLogLike += treeRoot.logFelsSingle(*this, alignedPos3, felsWorkspace);
 				}
 
 				double logRatio = pairedLogLike - singleLogLike;
@@ -2222,9 +2262,9 @@ void Alignment::printCompetingHelixTrueHelixMidpoints(Tree & treeRoot, const dou
 			int pos5 = trueHelices[j]->pos5;
 			int pos3 = trueHelices[j]->pos3;
 			for (int k = 0; k < trueHelices[j]->length; k++){
-				pairedLogLike += log(treeRoot.calcFelsDouble(*this, pos5+k, pos3-k));
-				singleLogLike += log(treeRoot.calcFelsSingle(*this, pos5+k));
-				singleLogLike += log(treeRoot.calcFelsSingle(*this, pos3-k));
+				pairedLogLike += log(treeRoot.calcFelsDouble(*this, pos5+k, pos3-k, felsWorkspace));
+				singleLogLike += log(treeRoot.calcFelsSingle(*this, pos5+k, felsWorkspace));
+				singleLogLike += log(treeRoot.calcFelsSingle(*this, pos3-k, felsWorkspace));
 			}
 
 			double trueHelixLogRatio = (pairedLogLike - singleLogLike) / trueHelices[j]->length;
@@ -2255,9 +2295,9 @@ void Alignment::printCompetingHelixTrueHelixMidpoints(Tree & treeRoot, const dou
 				for (int l = 0; l < length; l++){
 					int alignedPos5 = seq2AlignmentMap[i]->at(pos5+l);
 					int alignedPos3 = seq2AlignmentMap[i]->at(pos3-l);
-					pairedLogLike += log(treeRoot.calcFelsDouble(*this, alignedPos5 , alignedPos3));
-					singleLogLike += log(treeRoot.calcFelsSingle(*this, alignedPos5));
-					singleLogLike += log(treeRoot.calcFelsSingle(*this, alignedPos3));
+					pairedLogLike += log(treeRoot.calcFelsDouble(*this, alignedPos5 , alignedPos3, felsWorkspace));
+					singleLogLike += log(treeRoot.calcFelsSingle(*this, alignedPos5, felsWorkspace));
+					singleLogLike += log(treeRoot.calcFelsSingle(*this, alignedPos3, felsWorkspace));
 				}
 
 				double competingHelixLogRatio = (pairedLogLike - singleLogLike) / length;
@@ -3011,46 +3051,102 @@ double Alignment::calculatePercentOfCompetingHelicesInCores(){
 
 double Alignment::logLikelihood(int pos5, int pos3, Tree & tree){
 
-	double paired = felsDoubles[pos5]->at(pos3);
-	if(paired > 0){
-		paired = log(tree.calcFelsDouble(*this, pos5, pos3))/log(2);
-		assert(paired <= 0);
-		felsDoubles[pos5]->at(pos3) = paired;
+	double paired = logPairedLikelihood(pos5, pos3, tree);
+	double pos5Single = logUnpairedLikelihood(pos5, tree);
+	double pos3Single = logUnpairedLikelihood(pos3, tree);
+
+	return paired - pos5Single - pos3Single;
+}
+
+void Alignment::fillLikelihoodTables(Tree & tree, int minDist){
+	const double QUEUED = 2; //table entry of a pattern pair waiting in the current block
+
+	int pos5[CompiledTree::BLOCK_PAIRS];
+	int pos3[CompiledTree::BLOCK_PAIRS];
+	int count = 0;
+
+	int length = alignedStruct.size();
+	for(int i = 0; i < length; i++){
+		logUnpairedLikelihood(i, tree);
+
+		for(int j = i + minDist; j < length && j - i <= maxSpan; j++){
+			//add pair i-j to the block, unless its patterns are known or already queued
+			double entry = felsDoubles.get(columnPatterns[i], columnPatterns[j]);
+			if(entry > 0 && entry != QUEUED){
+				felsDoubles.at(columnPatterns[i], columnPatterns[j]) = QUEUED;
+				pos5[count] = i;
+				pos3[count] = j;
+				count++;
+				if(count == CompiledTree::BLOCK_PAIRS){
+					fillPairedBlock(tree, pos5, pos3, count);
+					count = 0;
+				}
+			}
+		}
+	}
+	if(count > 0){
+		fillPairedBlock(tree, pos5, pos3, count);
 	}
+}
 
-	double pos5Single = felsSingles[pos5];
-	if(pos5Single > 0){
-		pos5Single = log(tree.calcFelsSingle(*this, pos5))/log(2);
-		assert(pos5Single <= 0);
-		felsSingles[pos5] = pos5Single;
+void Alignment::fillPairedBlock(Tree & tree, const int * pos5, const int * pos3, int count){
+	double logLikelihoods[CompiledTree::BLOCK_PAIRS];
+	compiledTree(tree).logFelsDoubles(*this, pos5, pos3, count, felsWorkspace, logLikelihoods);
+	for(int k = 0; k < count; k++){
+		double paired = logLikelihoods[k];
+		assert(paired <= 0);
+		felsDoubles.at(columnPatterns[pos5[k]], columnPatterns[pos3[k]]) = paired;
 	}
+}
 
-	double pos3Single = felsSingles[pos3];
-	if(pos3Single > 0){
-		pos3Single = log(tree.calcFelsSingle(*this, pos3)) / log(2);
-		assert(pos3Single <= 0);
-		felsSingles[pos3] = pos3Single;
+CompiledTree & Alignment::compiledTree(const Tree & tree){
+	if(compiled == NULL || compiled->tree != &tree){
+		delete compiled;
+		compiled = new CompiledTree(tree, seqNames);
 	}
+	return *compiled;
+}
 
-	return paired - pos5Single - pos3Single;
+void Alignment::shareLikelihoods(ColumnLikelihoodCache * cache){
+	if(cache != NULL && sourceColumns.size() == alignedStruct.size()){
+		sharedLikelihoods = cache;
+	}
+	else{
+		sharedLikelihoods = NULL;
+	}
 }
 
 double Alignment::logPairedLikelihood(int pos5, int pos3, Tree & tree){
-	double paired = felsDoubles[pos5]->at(pos3);
+	int pattern5 = columnPatterns[pos5];
+	int pattern3 = columnPatterns[pos3];
+	double paired = felsDoubles.get(pattern5, pattern3);
 	if(paired > 0){
-		paired = log(tree.calcFelsDouble(*this, pos5, pos3))/log(2);
+		bool shared = sharedLikelihoods != NULL && sharedLikelihoods->tree == &tree;
+		if(!shared || !sharedLikelihoods->findPaired(pattern5, pattern3, paired)){
+			paired = tree.logFelsDouble(*this, pos5, pos3, felsWorkspace);
+			if(shared){
+				sharedLikelihoods->storePaired(pattern5, pattern3, paired);
+			}
+		}
 		assert(paired <= 0);
-		felsDoubles[pos5]->at(pos3) = paired;
+		felsDoubles.at(pattern5, pattern3) = paired;
 	}
 	return paired;
 }
 
 double Alignment::logUnpairedLikelihood(int pos, Tree & tree){
-	double posSingle = felsSingles[pos];
+	int pattern = columnPatterns[pos];
+	double posSingle = felsSingles[pattern];
 	if(posSingle > 0){
-		posSingle = log(tree.calcFelsSingle(*this, pos))/log(2);
+		bool shared = sharedLikelihoods != NULL && sharedLikelihoods->tree == &tree;
+		if(!shared || !sharedLikelihoods->findSingle(pattern, posSingle)){
+			posSingle = tree.logFelsSingle(*this, pos, felsWorkspace);
+			if(shared){
+				sharedLikelihoods->storeSingle(pattern, posSingle);
+			}
+		}
 		assert(posSingle <= 0);
-		felsSingles[pos] = posSingle;
+		felsSingles[pattern] = posSingle;
 	}
 
 	return posSingle;
@@ -3362,41 +3458,9 @@ void Alignment::printTrueHelixStats(Tree & tree){
 }
 
 double Alignment::consensusBPPercent(int pos5, int pos3){
-
-	if(consensusBP == NULL){
-		consensusBP = new UTMatrix(alignedStruct.size());
-
-		for(unsigned int i = 0; i < alignedStruct.size(); i++){
-			for(unsigned int j = i; j < alignedStruct.size(); j++){
-				consensusBP->set(i, j, -1);
-			}
-		}
-	}
-
-	if(consensusBP->at(pos5, pos3) < 0){
-		int total = 0;
-		int cbp = 0;
-		double cbp_percent;
-
-		for(unsigned int i = 0; i < alignedSeqs.size(); i++){
-			char a,b;
-			a = alignedSeqs[i]->at(pos5);
-			b = alignedSeqs[i]->at(pos3);
-
-			total++;
-			if(Utilities::validBP(a, b)){
-				cbp++;
-			}
-		}
-		assert(total > 0);
-		cbp_percent = cbp / (double) total;
-		consensusBP->set(pos5, pos3, cbp_percent);
-		return cbp_percent;
-	}
-	else{
-		return consensusBP->at(pos5, pos3);
-	}
-
+	ColumnProfiles & profiles = columnProfiles();
+	assert(profiles.sequenceCount() > 0);
+	return profiles.canonicalPairs(pos5, pos3) / (double) profiles.sequenceCount();
 }
 //double Alignment::noGapCBPPercent(int pos5, int pos3){
 //
@@ -3469,18 +3533,9 @@ double Alignment::noGapCBPPercent(CompetingHelix & helix, int seqIndex){
 		pos5 = seq2AlignmentMap[seqIndex]->at(helix.start5 + i);
 		pos3 = seq2AlignmentMap[seqIndex]->at(helix.end3 - i);
 
-		for(unsigned int j = 0; j < alignedSeqs.size(); j++){
-			char a,b;
-			a = alignedSeqs[j]->at(pos5);
-			b = alignedSeqs[j]->at(pos3);
-
-			if(a != '-' && b != '-'){
-				total++;
-				if(Utilities::validBP(a, b)){
-					cbp++;
-				}
-			}
-		}
+		//a canonical pair has no gaps
+		total += columnProfiles().sequenceCount() - columnProfiles().gaps(pos5, pos3);
+		cbp += columnProfiles().canonicalPairs(pos5, pos3);
 
 	}
 
@@ -3489,30 +3544,7 @@ double Alignment::noGapCBPPercent(CompetingHelix & helix, int seqIndex){
 }
 
 double Alignment::getGapFraction(unsigned int pos){
-	if (gapFraction == NULL){
-		gapFraction = new vector<double>();
-		for(unsigned int i = 0; i < alignedStruct.size(); i++){
-			gapFraction->push_back(-1);
-		}
-	}
-	if(gapFraction->at(pos) < 0){
-		int gaps = 0;
-		int total = 0;
-		double gf;
-		for(unsigned int i = 0; i < alignedSeqs.size(); i++){
-			char a = alignedSeqs[i]->at(pos);
-			if(a == '-'){
-				gaps++;
-			}
-			total++;
-		}
-		gf = gaps / (double)total;
-		(*gapFraction)[pos] = gf;
-		return gf;
-	}
-	else{
-		return gapFraction->at(pos);
-	}
+	return columnProfiles().gaps(pos) / (double)columnProfiles().sequenceCount();
 }
 
 double Alignment::getGapFraction(CompetingHelix & helix, int seqIndex){
@@ -3534,29 +3566,14 @@ double Alignment::getGapFraction(CompetingHelix & helix, int seqIndex){
 }
 
 double Alignment::getSeqCons(unsigned int pos){
-	if (seqCons == NULL){
-		seqCons = new vector<double>();
-		for(unsigned int i = 0; i < alignedStruct.size(); i++){
-			seqCons->push_back(-1);
-		}
-	}
-	if(seqCons->at(pos) < 0){
+	return columnProfiles().conservation(pos);
+}
 
-		int total = 0;
-		int matching = 0;
-		for(unsigned int i = 0; i < alignedSeqs.size() - 1; i++){
-			for(unsigned int j = i + 1; j < alignedSeqs.size(); j++){
-				if(toupper(alignedSeqs[i]->at(pos)) == toupper(alignedSeqs[j]->at(pos))){
-					matching++;
-				}
-				total++;
-			}
-		}
-		(*seqCons)[pos] = matching / (double) total;
-		//(*seqCons)[pos] = seqConservationAtPosition(pos);
+ColumnProfiles & Alignment::columnProfiles(){
+	if(profiles == NULL){
+		profiles = new ColumnProfiles(alignedSeqs);
 	}
-	return seqCons->at(pos);
-
+	return *profiles;
 }
 
 double Alignment::getSeqCons(CompetingHelix & helix, int seqIndex){
@@ -3594,37 +3611,7 @@ string Alignment::TrueHelixString(int th_index){
 }
 
 double Alignment::getCovariance(int pos5, int pos3){
-	int denom = 0;
-	int covariance = 0;
-	for(unsigned int i = 0; i < alignedSeqs.size() - 1; i++){
-
-		for(unsigned int j = i+1; j < alignedSeqs.size(); j++){
-			int hamming = 0;
-			char ia, ib, ja, jb;
-			ia = toupper(alignedSeqs[i]->at(pos5));
-			ib = toupper(alignedSeqs[i]->at(pos3));
-
-			ja = toupper(alignedSeqs[j]->at(pos5));
-			jb = toupper(alignedSeqs[j]->at(pos3));
-			if(ia == ja){
-				hamming++;
-			}
-			if(ib == jb){
-				hamming++;
-			}
-
-			if(hamming > 0){
-				if(Utilities::validBP(ia, ib) && Utilities::validBP(ja,jb)){
-					covariance += hamming;
-				}
-				else{
-					covariance -= hamming;
-				}
-			}
-			denom++;
-		}
-	}
-	return covariance / (double)denom;
+	return columnProfiles().covariance(pos5, pos3);
 }
 
 double Alignment::getCovariance(CompetingHelix & helix, int seqIndex){
@@ -3732,6 +3719,8 @@ string Alignment::ClustalWFormat(const vector<int> & columns){
 
 void Alignment::printHeatMap(Tree & tree){
 
+	fillLikelihoodTables(tree, 1);
+
 	cout << "Log-likelihood ratio matrix\n";
 	for(int i = 0; i < (int)alignedStruct.size(); i++){
 
@@ -3739,7 +3728,7 @@ void Alignment::printHeatMap(Tree & tree){
 			if(j != 0){
 				cout << "\t";
 			}
-			if (j > i){
+			if (j > i && j - i <= maxSpan){
 				cout << logLikelihood(i,j, tree);
 			}
 			else{
@@ -3753,10 +3742,12 @@ void Alignment::printHeatMap(Tree & tree){
 
 void Alignment::sparseBpTable(Tree & tree){
 
+	//features include the pairs just inside each pair, which can be closer than MIN_DIST
+	fillLikelihoodTables(tree, 1);
 
 	double treeLength = tree.totalLength();
 	for(unsigned int i = 0; i < alignedStruct.size()-MIN_DIST; i++){
-		for(int j = i + MIN_DIST; j < (int)alignedStruct.size(); j++){
+		for(int j = i + MIN_DIST; j < (int)alignedStruct.size() && j - (int)i <= maxSpan; j++){
 			int featureCount = 1;
 			if(alignedStruct[i] == j){
 				cout << "+1 ";
@@ -27,6 +27,10 @@
 #include "Helix.h"
 #include "UTMatrix.h"
 #include "HelixFinder.h"
+#include "FelsWorkspace.h"
+#include "CompiledTree.h"
+#include "ColumnLikelihoodCache.h"
+#include "PairTable.h"
 
 //Some of these are unused, I think...
 #define MAX_SEQ_L  4500    // maximal sequence length
@@ -38,6 +42,7 @@ using namespace std;
 
 //forward declaration... Maybe this is avoidable?
 class Tree;
+class ColumnProfiles;
 
 class Alignment {
 public:
@@ -73,6 +78,14 @@ public:
 	 */
 	void sequenceGStats(const double eStack[4][4][4][4], const int seqIndex);
 
+	/**
+	 * returns the maximal stems of sequence seqIndex (see StemFinder::findStems), for the
+	 * current minStemLength and maxSpan. The stems of a sequence are searched for once,
+	 * and shared by everything that uses them (HelixFinder, sequenceGStats).
+	 * Different threads may ask for the stems of different sequences at the same time.
+	 */
+	const vector<Helix> & sequenceStems(int seqIndex);
+
 	/**
 	 * various methods for printing information about the alignment, mostly for debugging
 	 * purposes.
@@ -346,6 +359,14 @@ public:
 	double logPairedLikelihood(int pos5, int pos3, Tree & tree);
 	double logUnpairedLikelihood(int pos, Tree & tree);
 
+	/**
+	 * fills the log-likelihood tables for every column, and every pair of columns at least
+	 * minDist apart, so that later calls to the functions above are table lookups.
+	 * Much faster than calling them pair by pair: pairs go through the tree in blocks
+	 * (see CompiledTree::logFelsDoubles)
+	 */
+	void fillLikelihoodTables(Tree & tree, int minDist);
+
 
 	/**
 	 * re-aligns the sequences in the alignment within the interval [begin, end)
@@ -377,6 +398,13 @@ public:
 
 	static int minStemLength;
 
+	/**
+	 * maximum distance j - i between the positions of a base pair i-j: in each sequence
+	 * for the helix searches, and in the alignment for the column pair tables.
+	 * Default = INT_MAX (no limit)
+	 */
+	static int maxSpan;
+
 	/**
 	 * if printHeaders is true, print header line containing column descriptions
 	 * for data generating methods.
@@ -414,6 +442,30 @@ public:
 	//Dimension 2: True Helices
 	//Dimension 3: Competing Helices
 
+	/**
+	 * scratch space for likelihood calculations on this alignment
+	 */
+	FelsWorkspace felsWorkspace;
+
+	/**
+	 * returns tree compiled for this alignment (built on first use, and again
+	 * whenever a different tree is passed)
+	 */
+	CompiledTree & compiledTree(const Tree & tree);
+
+	/**
+	 * for each column, the index of its column pattern. Columns with identical contents
+	 * share a pattern, and their likelihoods are only computed once (see compressColumns())
+	 */
+	vector<int> columnPatterns;
+	int patternCount;
+
+	/**
+	 * look up and store likelihoods in cache, shared with other alignments made of the same columns.
+	 * Only used if the original column of each column of this alignment is known (see sourceColumns).
+	 */
+	void shareLikelihoods(ColumnLikelihoodCache * cache);
+
 	/**
 	 * used for realignInterval... should really be gotten rid of
 	 */
@@ -425,16 +477,43 @@ protected:
 
 	/**
 	 * Log-odds matrices:
-	 * look-up table to avoid recalculating log-odds scores for columns
-	 * If any entry is > 0, that means it has yet to be calculated
+	 * look-up table to avoid recalculating log-odds scores for columns,
+	 * indexed by column pattern (patternCount x patternCount, resp. patternCount)
+	 * If any entry is > 0, that means it has yet to be calculated. felsDoubles only
+	 * allocates the parts of the table that are written
 	 */
-	vector<vector<double>* > felsDoubles;
+	PairTable felsDoubles;
 	vector<double> felsSingles;
 
-	vector<double> * gapFraction;//stores the fraction of gaps for each column
-	vector<double> * seqCons;//stores sequence conservation score for each column
+	ColumnProfiles * profiles; //see columnProfiles()
 
-	UTMatrix * consensusBP;
+	/**
+	 * symbol counts and bit-sliced columns, for the per-column statistics (sequence
+	 * conservation, covariance, canonical pairs and gaps; calculated when first needed)
+	 */
+	ColumnProfiles & columnProfiles();
+
+	CompiledTree * compiled; //see compiledTree()
+
+	ColumnLikelihoodCache * sharedLikelihoods; //see shareLikelihoods()
+
+	/**
+	 * for each column, the index of the column it was copied from in the alignment that
+	 * sharedLikelihoods belongs to. Empty if unknown.
+	 */
+	vector<int> sourceColumns;
+
+	/**
+	 * number the distinct columns of the alignment and fill columnPatterns, unless
+	 * the patterns were already set (e.g. copied along with the columns from another alignment)
+	 */
+	void compressColumns();
+
+	/**
+	 * calculates the paired log-likelihoods of a block of column pairs and stores them
+	 * in felsDoubles (see fillLikelihoodTables)
+	 */
+	void fillPairedBlock(Tree & tree, const int * pos5, const int * pos3, int count);
 
     void readAlignment(string & filename, bool includesStruct = false);
     void readStruct(string& filename);
@@ -478,6 +557,24 @@ protected:
 
     void initializeStatsMatrix();
 
+	/**
+	 * stems of each sequence (NULL until asked for), and the minStemLength and maxSpan
+	 * they were found with (see sequenceStems())
+	 */
+	vector<vector<Helix>*> stemCache;
+	vector<pair<int, int> > stemCacheSettings;
+
+	/**
+	 * indices into the stems of each sequence, ordered by their outer 3' position, then
+	 * from the inside out (the order sequenceGStats uses them in). Filled with stemCache
+	 */
+	vector<vector<int> > stemOrder;
+
+	/**
+	 * deletes the stems of all sequences
+	 */
+	void clearStems();
+
     /**
      * clears all stored vectors containing stats and sequence information
      */
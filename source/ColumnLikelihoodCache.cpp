@@ -0,0 +1,96 @@
+/*
+ * Copyright: Nicholas P Wiebe (2008-2009) and Irmtraud M Meyer (2008-2009)
+ * License: licensed under the GNU General Public License version 3 (GPLv3)
+ */
+
+#include "ColumnLikelihoodCache.h"
+#include <cassert>
+
+ColumnLikelihoodCache::ColumnLikelihoodCache(int columns_, const Tree & tree_) : tree(&tree_), columns(columns_), singles(columns_, 1) {
+	for(int i = 0; i < SHARDS; i++){
+		pthread_mutex_init(&pairedLocks[i], NULL);
+	}
+	pthread_mutex_init(&singleLock, NULL);
+
+	for(int i = 0; i <= SHARDS; i++){
+		hitCount[i] = 0;
+		lookupCount[i] = 0;
+	}
+}
+
+ColumnLikelihoodCache::~ColumnLikelihoodCache() {
+	for(int i = 0; i < SHARDS; i++){
+		pthread_mutex_destroy(&pairedLocks[i]);
+	}
+	pthread_mutex_destroy(&singleLock);
+}
+
+bool ColumnLikelihoodCache::findPaired(int col5, int col3, double & logLike){
+	assert(col5 >= 0 && col5 < columns);
+	assert(col3 >= 0 && col3 < columns);
+
+	long key = col5 * (long)columns + col3;
+	int shard = key % SHARDS;
+	bool found = false;
+
+	pthread_mutex_lock(&pairedLocks[shard]);
+	map<long, double>::iterator it = paired[shard].find(key);
+	if(it != paired[shard].end()){
+		logLike = it->second;
+		found = true;
+		hitCount[shard]++;
+	}
+	lookupCount[shard]++;
+	pthread_mutex_unlock(&pairedLocks[shard]);
+
+	return found;
+}
+
+void ColumnLikelihoodCache::storePaired(int col5, int col3, double logLike){
+	long key = col5 * (long)columns + col3;
+	int shard = key % SHARDS;
+
+	pthread_mutex_lock(&pairedLocks[shard]);
+	paired[shard][key] = logLike;
+	pthread_mutex_unlock(&pairedLocks[shard]);
+}
+
+bool ColumnLikelihoodCache::findSingle(int col, double & logLike){
+	assert(col >= 0 && col < columns);
+	bool found = false;
+
+	pthread_mutex_lock(&singleLock);
+	if(singles[col] <= 0){
+		logLike = singles[col];
+		found = true;
+		hitCount[SHARDS]++;
+	}
+	lookupCount[SHARDS]++;
+	pthread_mutex_unlock(&singleLock);
+
+	return found;
+}
+
+void ColumnLikelihoodCache::storeSingle(int col, double logLike){
+	assert(logLike <= 0);
+
+	pthread_mutex_lock(&singleLock);
+	singles[col] = logLike;
+	pthread_mutex_unlock(&singleLock);
+}
+
+unsigned long ColumnLikelihoodCache::hits(){
+	unsigned long total = 0;
+	for(int i = 0; i <= SHARDS; i++){
+		total += hitCount[i];
+	}
+	return total;
+}
+
+unsigned long ColumnLikelihoodCache::lookups(){
+	unsigned long total = 0;
+	for(int i = 0; i <= SHARDS; i++){
+		total += lookupCount[i];
+	}
+	return total;
+}
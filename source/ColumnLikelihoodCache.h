@@ -0,0 +1,69 @@
+/*
+ * Copyright: Nicholas P Wiebe (2008-2009) and Irmtraud M Meyer (2008-2009)
+ * License: licensed under the GNU General Public License version 3 (GPLv3)
+ * ColumnLikelihoodCache.h
+ *
+ * Log-likelihoods of the columns (and pairs of columns) of one alignment, shared
+ * by all alignments whose columns are copies of its columns. Level 1 shuffling only
+ * permutes whole columns, so every randomized alignment generated from an alignment
+ * can look its likelihoods up here by original column pattern (see
+ * Alignment::columnPatterns), instead of running the Felsenstein algorithm again
+ * for every sample.
+ *
+ * Thread safe: entries are spread over several independently locked shards.
+ */
+
+#ifndef COLUMNLIKELIHOODCACHE_H_
+#define COLUMNLIKELIHOODCACHE_H_
+
+#include <map>
+#include <vector>
+#include <pthread.h>
+
+using namespace std;
+
+class Tree;
+
+class ColumnLikelihoodCache {
+public:
+	/**
+	 * cache for the column patterns of an alignment with 'columns' distinct patterns,
+	 * with likelihoods under 'tree'
+	 */
+	ColumnLikelihoodCache(int columns, const Tree & tree);
+	virtual ~ColumnLikelihoodCache();
+
+	/**
+	 * if the log-likelihood of the pair of column patterns col5-col3 (resp. the single
+	 * pattern col) is known, set logLike to it and return true. Otherwise return false.
+	 */
+	bool findPaired(int col5, int col3, double & logLike);
+	bool findSingle(int col, double & logLike);
+
+	void storePaired(int col5, int col3, double logLike);
+	void storeSingle(int col, double logLike);
+
+	/**
+	 * number of lookups that were answered from the cache, and total number of lookups
+	 */
+	unsigned long hits();
+	unsigned long lookups();
+
+	const Tree * tree;
+
+private:
+	static const int SHARDS = 64;
+
+	int columns;
+
+	pthread_mutex_t pairedLocks[SHARDS];
+	map<long, double> paired[SHARDS]; //key: col5 * columns + col3
+
+	pthread_mutex_t singleLock;
+	vector<double> singles; //> 0 means not yet known
+
+	unsigned long hitCount[SHARDS + 1];
+	unsigned long lookupCount[SHARDS + 1];
+};
+
+#endif /* COLUMNLIKELIHOODCACHE_H_ */
@@ -0,0 +1,167 @@
+/*
+ * Copyright: Nicholas P Wiebe (2008-2009) and Irmtraud M Meyer (2008-2009)
+ * License: licensed under the GNU General Public License version 3 (GPLv3)
+ */
+
+#include "ColumnProfiles.h"
+#include "Utilities.h"
+#include <cctype>
+
+ColumnProfiles::ColumnProfiles(const vector<string*> & alignedSeqs) : seqCount(alignedSeqs.size()){
+	int length = alignedSeqs.empty() ? 0 : alignedSeqs[0]->length();
+
+	//code each symbol by its index in symbols
+	int code[256];
+	for(int c = 0; c < 256; c++){
+		code[c] = -1;
+	}
+	codes.assign(length, vector<unsigned char>(seqCount));
+	words = (seqCount + 63) / 64;
+	slices.assign((long)length * SLICES * words, 0);
+	for(int i = 0; i < seqCount; i++){
+		for(int pos = 0; pos < length; pos++){
+			unsigned char symbol = toupper(alignedSeqs[i]->at(pos));
+			if(code[symbol] < 0){
+				code[symbol] = symbols.size();
+				symbols.push_back(symbol);
+			}
+			codes[pos][i] = code[symbol];
+
+			int s;
+			switch(symbol){
+			case 'A': s = A_SLICE; break;
+			case 'C': s = C_SLICE; break;
+			case 'G': s = G_SLICE; break;
+			case 'U':
+			case 'T': s = U_SLICE; break;
+			case '-': s = GAP_SLICE; break;
+			default: s = SLICES; break;
+			}
+			if(s != SLICES){
+				slices[((long)pos * SLICES + s) * words + i / 64] |= (uint64_t)1 << (i % 64);
+			}
+		}
+	}
+
+	int symbolCount = symbols.size();
+	canPair.assign(symbolCount * symbolCount, false);
+	for(int a = 0; a < symbolCount; a++){
+		for(int b = 0; b < symbolCount; b++){
+			canPair[a * symbolCount + b] = Utilities::validBP(symbols[a], symbols[b]);
+		}
+	}
+
+	//sequence pairs with the same symbol: n choose 2 for each symbol
+	long total = (long)seqCount * (seqCount - 1) / 2;
+	vector<long> counts(symbolCount);
+	conservations.resize(length);
+	for(int pos = 0; pos < length; pos++){
+		counts.assign(symbolCount, 0);
+		for(int i = 0; i < seqCount; i++){
+			counts[codes[pos][i]]++;
+		}
+		long matching = 0;
+		for(int a = 0; a < symbolCount; a++){
+			matching += counts[a] * (counts[a] - 1) / 2;
+		}
+		conservations[pos] = matching / (double) total;
+	}
+}
+
+ColumnProfiles::~ColumnProfiles() {
+}
+
+double ColumnProfiles::conservation(int pos) const{
+	return conservations[pos];
+}
+
+double ColumnProfiles::covariance(int pos5, int pos3) const{
+	int symbolCount = symbols.size();
+
+	//number of sequences with each symbol pair at pos5-pos3, and the pairs present.
+	//Local, so that covariance() can be called from several threads: there are only a
+	//few symbols, so this costs little next to the pass over the sequences
+	vector<long> counts(symbolCount * symbolCount, 0);
+	vector<int> present;
+	const vector<unsigned char> & codes5 = codes[pos5];
+	const vector<unsigned char> & codes3 = codes[pos3];
+	for(int i = 0; i < seqCount; i++){
+		int bp = codes5[i] * symbolCount + codes3[i];
+		if(counts[bp]++ == 0){
+			present.push_back(bp);
+		}
+	}
+
+	long covariance = 0;
+	for(unsigned int j = 0; j < present.size(); j++){
+		int a = present[j];
+		long na = counts[a];
+
+		//pairs of sequences with the same symbol pair agree in both columns
+		covariance += (canPair[a] ? 2 : -2) * (na * (na - 1) / 2);
+
+		for(unsigned int k = j + 1; k < present.size(); k++){
+			int b = present[k];
+			int hamming = 0;
+			if(a / symbolCount == b / symbolCount){
+				hamming++;
+			}
+			if(a % symbolCount == b % symbolCount){
+				hamming++;
+			}
+			if(hamming > 0){
+				covariance += ((canPair[a] && canPair[b]) ? hamming : -hamming) * na * counts[b];
+			}
+		}
+	}
+
+	long denom = (long)seqCount * (seqCount - 1) / 2;
+	return covariance / (double)denom;
+}
+
+const uint64_t * ColumnProfiles::slice(int pos, Slice s) const{
+	return &slices[((long)pos * SLICES + s) * words];
+}
+
+int ColumnProfiles::canonicalPairs(int pos5, int pos3) const{
+	const uint64_t * a5 = slice(pos5, A_SLICE);
+	const uint64_t * c5 = slice(pos5, C_SLICE);
+	const uint64_t * g5 = slice(pos5, G_SLICE);
+	const uint64_t * u5 = slice(pos5, U_SLICE);
+	const uint64_t * a3 = slice(pos3, A_SLICE);
+	const uint64_t * c3 = slice(pos3, C_SLICE);
+	const uint64_t * g3 = slice(pos3, G_SLICE);
+	const uint64_t * u3 = slice(pos3, U_SLICE);
+
+	int pairs = 0;
+	for(int w = 0; w < words; w++){
+		uint64_t canonical = (a5[w] & u3[w]) | (u5[w] & (a3[w] | g3[w])) | (g5[w] & (c3[w] | u3[w])) | (c5[w] & g3[w]);
+		pairs += __builtin_popcountll(canonical);
+	}
+	return pairs;
+}
+
+int ColumnProfiles::gaps(int pos) const{
+	const uint64_t * gap = slice(pos, GAP_SLICE);
+
+	int count = 0;
+	for(int w = 0; w < words; w++){
+		count += __builtin_popcountll(gap[w]);
+	}
+	return count;
+}
+
+int ColumnProfiles::gaps(int pos5, int pos3) const{
+	const uint64_t * gap5 = slice(pos5, GAP_SLICE);
+	const uint64_t * gap3 = slice(pos3, GAP_SLICE);
+
+	int count = 0;
+	for(int w = 0; w < words; w++){
+		count += __builtin_popcountll(gap5[w] | gap3[w]);
+	}
+	return count;
+}
+
+int ColumnProfiles::sequenceCount() const{
+	return seqCount;
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright: Nicholas P Wiebe (2008-2009) and Irmtraud M Meyer (2008-2009)
+ * License: licensed under the GNU General Public License version 3 (GPLv3)
+ * ColumnProfiles.h
+ *
+ * Column statistics of an alignment that compare every pair of sequences (sequence
+ * conservation and covariance), calculated from symbol counts instead of pair by pair.
+ * A pair of sequences only contributes according to the symbols the two sequences have
+ * in the column(s), so summing over the pairs of distinct symbols (resp. symbol pairs),
+ * weighted by how many sequences have them, gives exactly the same values in O(N).
+ *
+ * Each column is also stored bit-sliced: one bit per sequence for each nucleotide (upper or
+ * lower case, T counted as U) and for gaps. The sequences with a canonical pair at two
+ * columns are then found with a few ANDs and ORs of N/64 words, and counted with popcount.
+ */
+
+#ifndef COLUMNPROFILES_H_
+#define COLUMNPROFILES_H_
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+using namespace std;
+
+class ColumnProfiles {
+public:
+	ColumnProfiles(const vector<string*> & alignedSeqs);
+	virtual ~ColumnProfiles();
+
+	/**
+	 * fraction of pairs of sequences with the same (upper case) symbol at pos
+	 */
+	double conservation(int pos) const;
+
+	/**
+	 * covariance of the columns pos5 and pos3: over all pairs of sequences, the number
+	 * of the two columns in which they agree, counted positively if both sequences can
+	 * pair pos5 with pos3 and negatively otherwise, divided by the number of pairs
+	 */
+	double covariance(int pos5, int pos3) const;
+
+	/**
+	 * number of sequences in which the bases at pos5 and pos3 form a canonical (Watson-Crick
+	 * or GU) base pair
+	 */
+	int canonicalPairs(int pos5, int pos3) const;
+
+	/**
+	 * number of sequences with a gap at pos
+	 */
+	int gaps(int pos) const;
+
+	/**
+	 * number of sequences with a gap at pos5, pos3 or both
+	 */
+	int gaps(int pos5, int pos3) const;
+
+	int sequenceCount() const;
+
+private:
+	int seqCount;
+
+	/**
+	 * the distinct (upper case) symbols of the alignment
+	 */
+	vector<char> symbols;
+
+	/**
+	 * codes[pos][i] is the index in symbols of the symbol of sequence i at column pos
+	 */
+	vector<vector<unsigned char> > codes;
+
+	/**
+	 * canPair[a * symbols.size() + b] is true if symbols a and b form a valid base pair
+	 */
+	vector<bool> canPair;
+
+	vector<double> conservations;
+
+	enum Slice { A_SLICE, C_SLICE, G_SLICE, U_SLICE, GAP_SLICE, SLICES };
+
+	/**
+	 * 64-bit words per slice
+	 */
+	int words;
+
+	/**
+	 * the bit-sliced columns: bit i of slice s of column pos is set if sequence i has
+	 * that nucleotide (or a gap) at pos. Slice s of column pos starts at word
+	 * (pos * SLICES + s) * words
+	 */
+	vector<uint64_t> slices;
+
+	const uint64_t * slice(int pos, Slice s) const;
+};
+
+#endif /* COLUMNPROFILES_H_ */
@@ -0,0 +1,632 @@
+/*
+ * Copyright: Nicholas P Wiebe (2008-2009) and Irmtraud M Meyer (2008-2009)
+ * License: licensed under the GNU General Public License version 3 (GPLv3)
+ */
+
+#include "CompiledTree.h"
+#include "Tree.h"
+#include "Alignment.h"
+#include "EvolModel.h"
+#include "Utilities.h"
+#include <iostream>
+#include <cassert>
+#include <cstdlib>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define VECTOR_KERNELS
+#endif
+
+FelsKernel CompiledTree::kernel = AUTO_KERNEL;
+
+/**
+ * leaf partial likelihoods, precomputed for every symbol (or pair of symbols).
+ * Symbols are indexed by their nucleotide mask, with GAP_CODE for gaps and Ns: in the paired
+ * model they can stand for a base that cannot pair with the other one (see Tree::nonGapPair)
+ */
+static const int GAP_CODE = 16;
+
+struct LeafTips {
+	double paired[2][GAP_CODE + 1][GAP_CODE + 1][16]; //[Tree::nonGapPair][5' code][3' code]
+	double single[16][4]; //[mask]
+
+	LeafTips(){
+		for(int mask = 0; mask < 16; mask++){
+			for(int i = 0; i < 4; i++){
+				single[mask][i] = (mask >> i) & 1;
+			}
+		}
+
+		for(int nonGapPair = 0; nonGapPair < 2; nonGapPair++){
+			for(int code5 = 0; code5 <= GAP_CODE; code5++){
+				for(int code3 = 0; code3 <= GAP_CODE; code3++){
+					int mask5 = (code5 == GAP_CODE) ? 15 : code5;
+					int mask3 = (code3 == GAP_CODE) ? 15 : code3;
+					if(nonGapPair && code5 == GAP_CODE && code3 != GAP_CODE){
+						//case: 5' base is a gap, and the other is not
+						mask5 = nonPairingGapMask(mask3);
+					}
+					else if(nonGapPair && code3 == GAP_CODE && code5 != GAP_CODE){
+						//case 3' base is a gap, and the other is not
+						mask3 = nonPairingGapMask(mask5);
+					}
+					for(int i = 0; i < 4; i++){
+						for(int j = 0; j < 4; j++){
+							paired[nonGapPair][code5][code3][4 * i + j] = ((mask5 >> i) & 1) * ((mask3 >> j) & 1);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	/**
+	 * mask of the bases that cannot pair with any of the bases in the mask nongap.
+	 * note: special chars 'b', 'd' and 'k' produce an all-zero mask... So watch out!
+	 */
+	static int nonPairingGapMask(int nongap){
+		int mask = 15;
+		if(nongap & 1){
+			//A
+			mask &= ~2;
+		}
+		if(nongap & 2){
+			//U
+			mask &= ~(1 | 4);
+		}
+		if(nongap & 4){
+			//G
+			mask &= ~(2 | 8);
+		}
+		if(nongap & 8){
+			//C
+			mask &= ~4;
+		}
+		return mask;
+	}
+};
+
+static const LeafTips leafTips;
+
+/**
+ * index of base in LeafTips
+ */
+static inline int leafCode(char base){
+	if(base == '-' || base == 'N' || base == 'n'){
+		return GAP_CODE;
+	}
+	return Utilities::interpretMask(base);
+}
+
+/*
+ * Product kernels. All of them sum the terms of each row in the same order as the
+ * scalar loop, and none of them fuses multiply and add, so they give bit-identical
+ * likelihoods: p-values count null helices scoring at least as well as the observed
+ * one, and a difference in the last bit can change such ties.
+ */
+
+static void productScalar16(const double * leftMatrix, const double * leftFels,
+		const double * rightMatrix, const double * rightFels, double * fels){
+	for(int i = 0; i < 16; i++){
+		double temp1 = 0.0;
+		double temp2 = 0.0;
+		for(int j = 0; j < 16; j++){
+			temp1 += leftMatrix[16 * i + j] * leftFels[j];
+			temp2 += rightMatrix[16 * i + j] * rightFels[j];
+		}
+		fels[i] = temp1 * temp2;
+	}
+}
+
+static void productScalar4(const double * leftMatrix, const double * leftFels,
+		const double * rightMatrix, const double * rightFels, double * fels){
+	for(int i = 0; i < 4; i++){
+		double temp1 = 0.0;
+		double temp2 = 0.0;
+		for(int j = 0; j < 4; j++){
+			temp1 += leftMatrix[4 * i + j] * leftFels[j];
+			temp2 += rightMatrix[4 * i + j] * rightFels[j];
+		}
+		fels[i] = temp1 * temp2;
+	}
+}
+
+#ifdef VECTOR_KERNELS
+
+//column major matrices: column j is the contiguous block matrix[16 * j .. 16 * j + 15]
+
+static void productSse2_16(const double * leftMatrix, const double * leftFels,
+		const double * rightMatrix, const double * rightFels, double * fels){
+	__m128d left[8], right[8];
+	for(int k = 0; k < 8; k++){
+		left[k] = _mm_setzero_pd();
+		right[k] = _mm_setzero_pd();
+	}
+	for(int j = 0; j < 16; j++){
+		__m128d lf = _mm_set1_pd(leftFels[j]);
+		__m128d rf = _mm_set1_pd(rightFels[j]);
+		const double * leftColumn = leftMatrix + 16 * j;
+		const double * rightColumn = rightMatrix + 16 * j;
+		for(int k = 0; k < 8; k++){
+			left[k] = _mm_add_pd(left[k], _mm_mul_pd(_mm_load_pd(leftColumn + 2 * k), lf));
+			right[k] = _mm_add_pd(right[k], _mm_mul_pd(_mm_load_pd(rightColumn + 2 * k), rf));
+		}
+	}
+	for(int k = 0; k < 8; k++){
+		_mm_storeu_pd(fels + 2 * k, _mm_mul_pd(left[k], right[k]));
+	}
+}
+
+static void productSse2_4(const double * leftMatrix, const double * leftFels,
+		const double * rightMatrix, const double * rightFels, double * fels){
+	__m128d left0 = _mm_setzero_pd(), left1 = _mm_setzero_pd();
+	__m128d right0 = _mm_setzero_pd(), right1 = _mm_setzero_pd();
+	for(int j = 0; j < 4; j++){
+		__m128d lf = _mm_set1_pd(leftFels[j]);
+		__m128d rf = _mm_set1_pd(rightFels[j]);
+		left0 = _mm_add_pd(left0, _mm_mul_pd(_mm_load_pd(leftMatrix + 4 * j), lf));
+		left1 = _mm_add_pd(left1, _mm_mul_pd(_mm_load_pd(leftMatrix + 4 * j + 2), lf));
+		right0 = _mm_add_pd(right0, _mm_mul_pd(_mm_load_pd(rightMatrix + 4 * j), rf));
+		right1 = _mm_add_pd(right1, _mm_mul_pd(_mm_load_pd(rightMatrix + 4 * j + 2), rf));
+	}
+	_mm_storeu_pd(fels, _mm_mul_pd(left0, right0));
+	_mm_storeu_pd(fels + 2, _mm_mul_pd(left1, right1));
+}
+
+__attribute__((target("avx2")))
+static void productAvx2_16(const double * leftMatrix, const double * leftFels,
+		const double * rightMatrix, const double * rightFels, double * fels){
+	__m256d left0 = _mm256_setzero_pd(), left1 = _mm256_setzero_pd();
+	__m256d left2 = _mm256_setzero_pd(), left3 = _mm256_setzero_pd();
+	__m256d right0 = _mm256_setzero_pd(), right1 = _mm256_setzero_pd();
+	__m256d right2 = _mm256_setzero_pd(), right3 = _mm256_setzero_pd();
+	for(int j = 0; j < 16; j++){
+		__m256d lf = _mm256_broadcast_sd(leftFels + j);
+		__m256d rf = _mm256_broadcast_sd(rightFels + j);
+		const double * leftColumn = leftMatrix + 16 * j;
+		const double * rightColumn = rightMatrix + 16 * j;
+		left0 = _mm256_add_pd(left0, _mm256_mul_pd(_mm256_load_pd(leftColumn), lf));
+		left1 = _mm256_add_pd(left1, _mm256_mul_pd(_mm256_load_pd(leftColumn + 4), lf));
+		left2 = _mm256_add_pd(left2, _mm256_mul_pd(_mm256_load_pd(leftColumn + 8), lf));
+		left3 = _mm256_add_pd(left3, _mm256_mul_pd(_mm256_load_pd(leftColumn + 12), lf));
+		right0 = _mm256_add_pd(right0, _mm256_mul_pd(_mm256_load_pd(rightColumn), rf));
+		right1 = _mm256_add_pd(right1, _mm256_mul_pd(_mm256_load_pd(rightColumn + 4), rf));
+		right2 = _mm256_add_pd(right2, _mm256_mul_pd(_mm256_load_pd(rightColumn + 8), rf));
+		right3 = _mm256_add_pd(right3, _mm256_mul_pd(_mm256_load_pd(rightColumn + 12), rf));
+	}
+	_mm256_storeu_pd(fels, _mm256_mul_pd(left0, right0));
+	_mm256_storeu_pd(fels + 4, _mm256_mul_pd(left1, right1));
+	_mm256_storeu_pd(fels + 8, _mm256_mul_pd(left2, right2));
+	_mm256_storeu_pd(fels + 12, _mm256_mul_pd(left3, right3));
+}
+
+__attribute__((target("avx2")))
+static void productAvx2_4(const double * leftMatrix, const double * leftFels,
+		const double * rightMatrix, const double * rightFels, double * fels){
+	__m256d left = _mm256_setzero_pd();
+	__m256d right = _mm256_setzero_pd();
+	for(int j = 0; j < 4; j++){
+		left = _mm256_add_pd(left, _mm256_mul_pd(_mm256_load_pd(leftMatrix + 4 * j), _mm256_broadcast_sd(leftFels + j)));
+		right = _mm256_add_pd(right, _mm256_mul_pd(_mm256_load_pd(rightMatrix + 4 * j), _mm256_broadcast_sd(rightFels + j)));
+	}
+	_mm256_storeu_pd(fels, _mm256_mul_pd(left, right));
+}
+
+#endif
+
+/*
+ * Block kernels: the products of productScalar16 for a block of column pairs, in the
+ * structure of arrays layout of FelsWorkspace::blockFels (BLOCK_PAIRS values per state).
+ * Row major matrices; the loops run across pairs, LANES pairs at a time so that the
+ * sums stay in registers.
+ */
+
+static const int LANES = 8;
+
+static inline __attribute__((always_inline)) void blockProduct(const double * leftMatrix, const double * leftFels,
+		const double * rightMatrix, const double * rightFels, double * fels){
+	const int BLOCK_PAIRS = CompiledTree::BLOCK_PAIRS;
+	for(int i = 0; i < 16; i++){
+		for(int p0 = 0; p0 < BLOCK_PAIRS; p0 += LANES){
+			double left[LANES];
+			double right[LANES];
+			for(int p = 0; p < LANES; p++){
+				left[p] = 0.0;
+				right[p] = 0.0;
+			}
+			for(int j = 0; j < 16; j++){
+				double leftEntry = leftMatrix[16 * i + j];
+				double rightEntry = rightMatrix[16 * i + j];
+				const double * leftState = leftFels + BLOCK_PAIRS * j + p0;
+				const double * rightState = rightFels + BLOCK_PAIRS * j + p0;
+				for(int p = 0; p < LANES; p++){
+					left[p] += leftEntry * leftState[p];
+					right[p] += rightEntry * rightState[p];
+				}
+			}
+			double * state = fels + BLOCK_PAIRS * i + p0;
+			for(int p = 0; p < LANES; p++){
+				state[p] = left[p] * right[p];
+			}
+		}
+	}
+}
+
+static void blockProductDefault(const double * leftMatrix, const double * leftFels,
+		const double * rightMatrix, const double * rightFels, double * fels){
+	blockProduct(leftMatrix, leftFels, rightMatrix, rightFels, fels);
+}
+
+#ifdef VECTOR_KERNELS
+__attribute__((target("avx2")))
+static void blockProductAvx2(const double * leftMatrix, const double * leftFels,
+		const double * rightMatrix, const double * rightFels, double * fels){
+	blockProduct(leftMatrix, leftFels, rightMatrix, rightFels, fels);
+}
+#endif
+
+/**
+ * copies the n x n blocks of rowMajor to a new 64-byte aligned array, transposing them if columnMajor
+ */
+static double * kernelMatrices(const vector<double> & rowMajor, int n, bool columnMajor){
+	void * memory = NULL;
+	if(posix_memalign(&memory, 64, max((size_t)1, rowMajor.size()) * sizeof(double)) != 0){
+		cerr << "Error: could not allocate transition matrices\n";
+		exit(-1);
+	}
+	double * matrices = (double *)memory;
+	for(unsigned int block = 0; block < rowMajor.size(); block += n * n){
+		for(int i = 0; i < n; i++){
+			for(int j = 0; j < n; j++){
+				matrices[block + (columnMajor ? n * j + i : n * i + j)] = rowMajor[block + n * i + j];
+			}
+		}
+	}
+	return matrices;
+}
+
+FelsKernel CompiledTree::supportedKernel(FelsKernel k){
+#ifdef VECTOR_KERNELS
+	__builtin_cpu_init();
+	bool avx2 = __builtin_cpu_supports("avx2");
+	if(k == AUTO_KERNEL || (k == AVX2_KERNEL && !avx2)){
+		return avx2 ? AVX2_KERNEL : SSE2_KERNEL;
+	}
+	return k;
+#else
+	return SCALAR_KERNEL;
+#endif
+}
+
+const char * CompiledTree::kernelName(FelsKernel k){
+	switch(supportedKernel(k)){
+	case AVX2_KERNEL:
+		return "avx2";
+	case SSE2_KERNEL:
+		return "sse2";
+	default:
+		return "scalar";
+	}
+}
+
+void CompiledTree::productKernels(FelsKernel k, ProductKernel & product16, ProductKernel & product4, bool & columnMajor){
+	FelsKernel supported = supportedKernel(k);
+	product16 = productScalar16;
+	product4 = productScalar4;
+#ifdef VECTOR_KERNELS
+	if(supported == AVX2_KERNEL){
+		product16 = productAvx2_16;
+		product4 = productAvx2_4;
+	}
+	else if(supported == SSE2_KERNEL){
+		product16 = productSse2_16;
+		product4 = productSse2_4;
+	}
+#endif
+	columnMajor = supported != SCALAR_KERNEL;
+}
+
+CompiledTree::CompiledTree(const Tree & tree_, const vector<string*> & seqNames) : tree(&tree_) {
+	nodeCount = 0;
+
+	leftChild.reserve(tree_.nodeCount);
+	rightChild.reserve(tree_.nodeCount);
+	seqIndex.reserve(tree_.nodeCount);
+	matrix16.reserve(tree_.nodeCount * 256);
+	matrix4.reserve(tree_.nodeCount * 16);
+
+	compile(tree_, seqNames);
+	assert(nodeCount == tree_.nodeCount);
+
+	bool columnMajor;
+	productKernels(kernel, product16, product4, columnMajor);
+	blockProduct16 = blockProductDefault;
+#ifdef VECTOR_KERNELS
+	if(supportedKernel(kernel) == AVX2_KERNEL){
+		blockProduct16 = blockProductAvx2;
+	}
+#endif
+	kernelMatrix16 = kernelMatrices(matrix16, 16, columnMajor);
+	kernelMatrix4 = kernelMatrices(matrix4, 4, columnMajor);
+}
+
+CompiledTree::~CompiledTree() {
+	free(kernelMatrix16);
+	free(kernelMatrix4);
+}
+
+int CompiledTree::compile(const Tree & node, const vector<string*> & seqNames){
+	int left = -1;
+	int right = -1;
+	int leafSeq = -1;
+
+	if(node.leftChild == NULL && node.rightChild == NULL){
+		unsigned int i;
+		for(i = 0; i < seqNames.size(); i++){
+			if(node.seqName.compare(*seqNames[i]) == 0){
+				break;
+			}
+		}
+		if(i >= seqNames.size()){
+			cerr << "Error: tree sequence name not in set of alignment sequences\n";
+			cerr << "unrecognized name: " << node.seqName << endl;
+			cerr << "Alignment names:\n";
+			for(i = 0; i < seqNames.size();i++){
+				cerr << *seqNames[i] << endl;
+			}
+			exit(-1);
+		}
+		leafSeq = i;
+	}
+	else{
+		left = compile(*node.leftChild, seqNames);
+		right = compile(*node.rightChild, seqNames);
+	}
+
+	leftChild.push_back(left);
+	rightChild.push_back(right);
+	seqIndex.push_back(leafSeq);
+	for(int i = 0; i < 16; i++){
+		for(int j = 0; j < 16; j++){
+			matrix16.push_back(node.matrix16[i][j]);
+		}
+	}
+	for(int i = 0; i < 4; i++){
+		for(int j = 0; j < 4; j++){
+			matrix4.push_back(node.matrix4[i][j]);
+		}
+	}
+
+	return nodeCount++;
+}
+
+/**
+ * partials are rescaled by 2^SCALE_EXPONENT whenever all of a node's partials drop below
+ * 2^-SCALE_EXPONENT. Scaling by a power of two is exact, so likelihoods that never get
+ * that small are bit-for-bit the same as without scaling.
+ */
+static const int SCALE_EXPONENT = 256;
+static const double SCALE_THRESHOLD = ldexp(1.0, -SCALE_EXPONENT);
+static const double SCALE_FACTOR = ldexp(1.0, SCALE_EXPONENT);
+
+/**
+ * rescales the n partials in fels if they are all tiny (adding the exponent of the factor
+ * to scale), and clamps partials that are exactly zero to DBL_MIN. Returns the number
+ * of clamped partials.
+ */
+static unsigned int rescale(double * fels, int n, int stride, int & scale){
+	double largest = 0.0;
+	for(int i = 0; i < n; i++){
+		largest = max(largest, fels[stride * i]);
+	}
+	if(largest > 0.0 && largest < SCALE_THRESHOLD){
+		for(int i = 0; i < n; i++){
+			fels[stride * i] *= SCALE_FACTOR;
+		}
+		scale += SCALE_EXPONENT;
+	}
+
+	unsigned int zeros = 0;
+	for(int i = 0; i < n; i++){
+		if(fels[stride * i] <= 0.0){
+			fels[stride * i] = numeric_limits<double>::min();
+			zeros++;
+		}
+	}
+	return zeros;
+}
+
+double CompiledTree::calcFelsDouble(Alignment & a, int pos5, int pos3, FelsWorkspace & ws) const{
+	int scale = 0;
+	double likelihood = scaledFelsDouble(a, pos5, pos3, ws, scale);
+	return ldexp(likelihood, -scale);
+}
+
+double CompiledTree::logFelsDouble(Alignment & a, int pos5, int pos3, FelsWorkspace & ws) const{
+	int scale = 0;
+	double likelihood = scaledFelsDouble(a, pos5, pos3, ws, scale);
+	return log(likelihood)/log(2) - scale;
+}
+
+double CompiledTree::calcFelsSingle(Alignment & a, int pos, FelsWorkspace & ws) const{
+	int scale = 0;
+	double likelihood = scaledFelsSingle(a, pos, ws, scale);
+	return ldexp(likelihood, -scale);
+}
+
+double CompiledTree::logFelsSingle(Alignment & a, int pos, FelsWorkspace & ws) const{
+	int scale = 0;
+	double likelihood = scaledFelsSingle(a, pos, ws, scale);
+	return log(likelihood)/log(2) - scale;
+}
+
+double CompiledTree::scaledFelsDouble(Alignment & a, int pos5, int pos3, FelsWorkspace & ws, int & scale) const{
+	ws.reserve(nodeCount);
+
+	//children always come before their parent, so one pass in order fills every node
+	for(int node = 0; node < nodeCount; node++){
+		double * fels = &ws.fels[16 * node];
+
+		//leaf:
+		if(leftChild[node] < 0){
+			const string & seq = *a.alignedSeqs[seqIndex[node]];
+			pairedLeaf(seq[pos5], seq[pos3], fels);
+		}
+		//inner node
+		else{
+			const double * leftFels = &ws.fels[16 * leftChild[node]];
+			const double * rightFels = &ws.fels[16 * rightChild[node]];
+			const double * leftMatrix = kernelMatrix16 + 256 * leftChild[node];
+			const double * rightMatrix = kernelMatrix16 + 256 * rightChild[node];
+
+			// calculate the likelihood based on the likelihood of the two child nodes
+			product16(leftMatrix, leftFels, rightMatrix, rightFels, fels);
+			unsigned int zeros = rescale(fels, 16, 1, scale);
+			if(zeros > 0){
+				if(Tree::underflowWarnings && ws.felsDoubleUnderflows == 0){
+					cerr << "Warning: calcFelsDouble: zero partial likelihood...\n";
+				}
+				ws.felsDoubleUnderflows += zeros;
+			}
+		}
+	}
+	if(scale > 0){
+		ws.felsDoubleRescaled++;
+	}
+
+	//root
+	const double * fels = &ws.fels[16 * (nodeCount - 1)];
+	double likelihood = 0.0;
+	for(int i = 0; i < 16; i++){
+		likelihood += EvolModel::ePiDouble[i] * fels[i];
+	}
+
+	return likelihood;
+}
+
+void CompiledTree::logFelsDoubles(Alignment & a, const int * pos5, const int * pos3, int count,
+		FelsWorkspace & ws, double * logLikelihoods) const{
+	assert(count > 0 && count <= BLOCK_PAIRS);
+	ws.reserveBlock(nodeCount, BLOCK_PAIRS);
+
+	double leaf[16];
+	int scales[BLOCK_PAIRS];
+	for(int p = 0; p < BLOCK_PAIRS; p++){
+		scales[p] = 0;
+	}
+
+	for(int node = 0; node < nodeCount; node++){
+		double * fels = &ws.blockFels[16 * BLOCK_PAIRS * node];
+
+		//leaf: one column pair at a time
+		if(leftChild[node] < 0){
+			const string & seq = *a.alignedSeqs[seqIndex[node]];
+			for(int p = 0; p < count; p++){
+				pairedLeaf(seq[pos5[p]], seq[pos3[p]], leaf);
+				for(int i = 0; i < 16; i++){
+					fels[BLOCK_PAIRS * i + p] = leaf[i];
+				}
+			}
+			//pad short blocks: the kernel always works on BLOCK_PAIRS pairs
+			for(int p = count; p < BLOCK_PAIRS; p++){
+				for(int i = 0; i < 16; i++){
+					fels[BLOCK_PAIRS * i + p] = 1.0;
+				}
+			}
+		}
+		//inner node: all pairs at once, summing in the same order as calcFelsDouble
+		else{
+			const double * leftFels = &ws.blockFels[16 * BLOCK_PAIRS * leftChild[node]];
+			const double * rightFels = &ws.blockFels[16 * BLOCK_PAIRS * rightChild[node]];
+			const double * leftMatrix = &matrix16[256 * leftChild[node]];
+			const double * rightMatrix = &matrix16[256 * rightChild[node]];
+
+			blockProduct16(leftMatrix, leftFels, rightMatrix, rightFels, fels);
+
+			for(int p = 0; p < count; p++){
+				unsigned int zeros = rescale(fels + p, 16, BLOCK_PAIRS, scales[p]);
+				if(zeros > 0){
+					if(Tree::underflowWarnings && ws.felsDoubleUnderflows == 0){
+						cerr << "Warning: calcFelsDoubles: zero partial likelihood...\n";
+					}
+					ws.felsDoubleUnderflows += zeros;
+				}
+			}
+		}
+	}
+
+	//root
+	const double * fels = &ws.blockFels[16 * BLOCK_PAIRS * (nodeCount - 1)];
+	for(int p = 0; p < count; p++){
+		double likelihood = 0.0;
+		for(int i = 0; i < 16; i++){
+			likelihood += EvolModel::ePiDouble[i] * fels[BLOCK_PAIRS * i + p];
+		}
+		logLikelihoods[p] = log(likelihood)/log(2) - scales[p];
+		if(scales[p] > 0){
+			ws.felsDoubleRescaled++;
+		}
+	}
+}
+
+double CompiledTree::scaledFelsSingle(Alignment & a, int pos, FelsWorkspace & ws, int & scale) const{
+	ws.reserve(nodeCount);
+
+	for(int node = 0; node < nodeCount; node++){
+		double * fels = &ws.fels[16 * node];
+
+		//leaf
+		if(leftChild[node] < 0){
+			//interpret char
+			singleLeaf((*a.alignedSeqs[seqIndex[node]])[pos], fels);
+			//note: should fels be averaged, so that it sums to 1? will have to think about this...
+			//answer = no. See Felsenstein 1981, Extensions section
+
+		}
+		//inner node
+		else{
+			const double * leftFels = &ws.fels[16 * leftChild[node]];
+			const double * rightFels = &ws.fels[16 * rightChild[node]];
+			const double * leftMatrix = kernelMatrix4 + 16 * leftChild[node];
+			const double * rightMatrix = kernelMatrix4 + 16 * rightChild[node];
+
+			product4(leftMatrix, leftFels, rightMatrix, rightFels, fels);
+			unsigned int zeros = rescale(fels, 4, 1, scale);
+			if(zeros > 0){
+				if(Tree::underflowWarnings && ws.felsSingleUnderflows == 0){
+					cerr << "Warning: calcFelsSingle: zero partial likelihood...\n";
+				}
+				ws.felsSingleUnderflows += zeros;
+			}
+		}
+	}
+	if(scale > 0){
+		ws.felsSingleRescaled++;
+	}
+
+	//root
+	const double * fels = &ws.fels[16 * (nodeCount - 1)];
+	double likelihood = 0.0;
+	for(int i = 0; i < 4; i++){
+		likelihood += EvolModel::ePiSingle[i] * fels[i];
+	}
+
+	return likelihood;
+}
+
+void CompiledTree::pairedLeaf(char base5, char base3, double * fels){
+	const double * tip = leafTips.paired[Tree::nonGapPair][leafCode(base5)][leafCode(base3)];
+	for(int i = 0; i < 16; i++){
+		fels[i] = tip[i];
+	}
+}
+
+void CompiledTree::singleLeaf(char base, double * fels){
+	const double * tip = leafTips.single[Utilities::interpretMask(base)];
+	for(int i = 0; i < 4; i++){
+		fels[i] = tip[i];
+	}
+}
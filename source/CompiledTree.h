@@ -0,0 +1,152 @@
+/*
+ * Copyright: Nicholas P Wiebe (2008-2009) and Irmtraud M Meyer (2008-2009)
+ * License: licensed under the GNU General Public License version 3 (GPLv3)
+ * CompiledTree.h
+ *
+ * Flattened form of a Tree for likelihood calculations on one alignment.
+ * Nodes are stored in post-order (root last) in contiguous arrays, together with
+ * the transition matrices of their branches and, for leaves, the row of the
+ * alignment holding the leaf's sequence. The Felsenstein recursion then becomes
+ * one loop over the nodes, without name lookups or pointer chasing.
+ */
+
+#ifndef COMPILEDTREE_H_
+#define COMPILEDTREE_H_
+
+#include <vector>
+#include <string>
+#include "FelsWorkspace.h"
+
+using namespace std;
+
+class Tree;
+class Alignment;
+
+/**
+ * implementation of the matrix-vector products at inner nodes.
+ * AUTO_KERNEL picks the fastest one the processor supports
+ */
+enum FelsKernel { AUTO_KERNEL, SCALAR_KERNEL, SSE2_KERNEL, AVX2_KERNEL };
+
+/**
+ * computes fels = (leftMatrix * leftFels) .* (rightMatrix * rightFels)
+ * for the 16x16 (resp. 4x4) transition matrices of two sibling branches
+ */
+typedef void (*ProductKernel)(const double * leftMatrix, const double * leftFels,
+		const double * rightMatrix, const double * rightFels, double * fels);
+
+class CompiledTree {
+public:
+	/**
+	 * compiles tree for an alignment with sequences named seqNames
+	 */
+	CompiledTree(const Tree & tree, const vector<string*> & seqNames);
+	virtual ~CompiledTree();
+
+	/**
+	 * see Tree::calcFelsDouble, Tree::logFelsDouble etc.
+	 */
+	double calcFelsDouble(Alignment & a, int pos5, int pos3, FelsWorkspace & ws) const;
+	double calcFelsSingle(Alignment & a, int pos, FelsWorkspace & ws) const;
+	double logFelsDouble(Alignment & a, int pos5, int pos3, FelsWorkspace & ws) const;
+	double logFelsSingle(Alignment & a, int pos, FelsWorkspace & ws) const;
+
+	/**
+	 * log (base 2) likelihoods of the column pairs pos5[k]-pos3[k], k < count, in one pass
+	 * over the tree. Each transition matrix entry is loaded once for the whole block, and the
+	 * loops run across pairs. Gives the same values as logFelsDouble. count must be at most BLOCK_PAIRS
+	 */
+	void logFelsDoubles(Alignment & a, const int * pos5, const int * pos3, int count,
+			FelsWorkspace & ws, double * logLikelihoods) const;
+
+	static const int BLOCK_PAIRS = 32;
+
+	/**
+	 * the tree this was compiled from
+	 */
+	const Tree * tree;
+
+	int nodeCount;
+
+	/**
+	 * for each node: index of left and right children (-1 for leaves)
+	 */
+	vector<int> leftChild;
+	vector<int> rightChild;
+
+	/**
+	 * for each node: alignment row of the leaf's sequence (-1 for inner nodes)
+	 */
+	vector<int> seqIndex;
+
+	/**
+	 * transition matrices of the branch above each node, 16x16 (resp. 4x4) per node, row major
+	 */
+	vector<double> matrix16;
+	vector<double> matrix4;
+
+	/**
+	 * kernel used by all compiled trees, see FelsKernel. Set with -kernel
+	 */
+	static FelsKernel kernel;
+
+	/**
+	 * the kernel that runs when k is asked for: k, or the fastest one this processor
+	 * supports if k is AUTO_KERNEL or not supported
+	 */
+	static FelsKernel supportedKernel(FelsKernel k);
+
+	/**
+	 * name of the kernel that runs when k is asked for (default: the kernel in use)
+	 */
+	static const char * kernelName(FelsKernel k = kernel);
+
+	/**
+	 * the product kernels that run when k is asked for, for 16x16 and 4x4 matrices, and
+	 * whether they take the matrices column major (otherwise row major). The vector kernels
+	 * load whole blocks, so the matrices must be 32-byte aligned
+	 */
+	static void productKernels(FelsKernel k, ProductKernel & product16, ProductKernel & product4, bool & columnMajor);
+
+	/**
+	 * fills the 16 leaf partial likelihoods of the pair of bases base5-base3
+	 * (a copy of a precomputed tip vector: no allocation)
+	 */
+	static void pairedLeaf(char base5, char base3, double * fels);
+
+	/**
+	 * fills the 4 leaf partial likelihoods of base, in the same way
+	 */
+	static void singleLeaf(char base, double * fels);
+
+private:
+	//not copyable: owns the aligned matrices
+	CompiledTree(const CompiledTree & other);
+	CompiledTree & operator=(const CompiledTree & other);
+
+	/**
+	 * copies of matrix16 and matrix4 in the layout product16 and product4 expect
+	 * (row major for the scalar kernel, column major for the vector kernels), 64-byte
+	 * aligned. A 16x16 or 4x4 block is a whole number of vectors, so blocks need no padding.
+	 */
+	double * kernelMatrix16;
+	double * kernelMatrix4;
+
+	ProductKernel product16;
+	ProductKernel product4;
+	ProductKernel blockProduct16; //for calcFelsDoubles: row major matrices, BLOCK_PAIRS column pairs
+
+	/**
+	 * appends the subtree rooted at node in post-order, returns its index
+	 */
+	int compile(const Tree & node, const vector<string*> & seqNames);
+
+	/**
+	 * likelihood of the column pair (resp. column), times 2^scale: partials that get too
+	 * small are rescaled on the way up the tree, and scale is the sum of the exponents used
+	 */
+	double scaledFelsDouble(Alignment & a, int pos5, int pos3, FelsWorkspace & ws, int & scale) const;
+	double scaledFelsSingle(Alignment & a, int pos, FelsWorkspace & ws, int & scale) const;
+};
+
+#endif /* COMPILEDTREE_H_ */
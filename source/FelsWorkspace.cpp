@@ -0,0 +1,28 @@
+/*
+ * Copyright: Nicholas P Wiebe (2008-2009) and Irmtraud M Meyer (2008-2009)
+ * License: licensed under the GNU General Public License version 3 (GPLv3)
+ */
+
+#include "FelsWorkspace.h"
+
+FelsWorkspace::FelsWorkspace() {
+	felsDoubleUnderflows = 0;
+	felsSingleUnderflows = 0;
+	felsDoubleRescaled = 0;
+	felsSingleRescaled = 0;
+}
+
+FelsWorkspace::~FelsWorkspace() {
+}
+
+void FelsWorkspace::reserve(int nodeCount){
+	if((int)fels.size() < nodeCount * 16){
+		fels.resize(nodeCount * 16);
+	}
+}
+
+void FelsWorkspace::reserveBlock(int nodeCount, int pairs){
+	if((int)blockFels.size() < nodeCount * 16 * pairs){
+		blockFels.resize(nodeCount * 16 * pairs);
+	}
+}
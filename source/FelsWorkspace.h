@@ -0,0 +1,60 @@
+/*
+ * Copyright: Nicholas P Wiebe (2008-2009) and Irmtraud M Meyer (2008-2009)
+ * License: licensed under the GNU General Public License version 3 (GPLv3)
+ * FelsWorkspace.h
+ *
+ * Scratch space for Tree::calcFelsDouble and Tree::calcFelsSingle.
+ * Holds the partial likelihoods of every node of the tree, so that the tree
+ * itself is never written to while calculating likelihoods. One tree can then
+ * be shared by several threads, as long as each thread uses its own workspace.
+ */
+
+#ifndef FELSWORKSPACE_H_
+#define FELSWORKSPACE_H_
+
+#include <vector>
+
+using namespace std;
+
+class FelsWorkspace {
+public:
+	FelsWorkspace();
+	virtual ~FelsWorkspace();
+
+	/**
+	 * makes sure there is room for 16 partial likelihoods for each of nodeCount nodes
+	 */
+	void reserve(int nodeCount);
+
+	/**
+	 * partial likelihoods, 16 per node, indexed by post-order node number
+	 */
+	vector<double> fels;
+
+	/**
+	 * makes sure there is room for the partial likelihoods of a block of 'pairs' column pairs
+	 */
+	void reserveBlock(int nodeCount, int pairs);
+
+	/**
+	 * partial likelihoods of a block of column pairs (see CompiledTree::logFelsDoubles),
+	 * structure of arrays: entry [(16 * node + state) * pairs + pair]
+	 */
+	vector<double> blockFels;
+
+	/**
+	 * number of partial likelihoods that were exactly zero (and were clamped to DBL_MIN)
+	 * in the paired and single models
+	 */
+	unsigned int felsDoubleUnderflows;
+	unsigned int felsSingleUnderflows;
+
+	/**
+	 * number of column pairs (resp. columns) whose partial likelihoods had to be
+	 * rescaled to avoid underflow
+	 */
+	unsigned int felsDoubleRescaled;
+	unsigned int felsSingleRescaled;
+};
+
+#endif /* FELSWORKSPACE_H_ */
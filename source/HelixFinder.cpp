@@ -7,6 +7,7 @@
 #include "Alignment.h"
 #include "Utilities.h"
 #include "AlignedHelix.h"
+#include "StemFinder.h"
 #include <cstdlib>
 #include <iostream>
 #include <algorithm>
@@ -14,192 +15,289 @@
 #include <cassert>
 #include <utility>
 #include <list>
+#include <map>
+#include <pthread.h>
+#include <limits>
+#include <climits>
 
 Realigner HelixFinder::realign = NO_REALIGN;
 bool HelixFinder::verbose_out = true;
+int HelixFinder::threads = 1;
+vector<int> HelixFinder::minStemLengths;
+double HelixFinder::minLogLikeRatio = -numeric_limits<double>::infinity();
+double HelixFinder::maxPvalue = 1;
+long HelixFinder::nullColumns = 0;
+long HelixFinder::nullPatterns = 0;
+unsigned long HelixFinder::likelihoodLookups = 0;
+unsigned long HelixFinder::likelihoodHits = 0;
+unsigned long HelixFinder::pairsRescaled = 0;
+unsigned long HelixFinder::columnsRescaled = 0;
+
+/**
+ * state shared by the worker threads of allHelicesPvalueTable
+ */
+struct NullSampler {
+	Alignment * startingAlignment;
+	Tree * tree;
+	const vector<unsigned int> * seeds;
+	const vector<double> * logLikeRatios;
+	const vector<int> * thresholds;
+	ColumnLikelihoodCache * likelihoods;
+
+	pthread_mutex_t lock;
+	unsigned int nextSample; //next sample to hand out to a worker
+
+	//per-sample results that cannot be added to pvalues yet, by sample index.
+	//pvalues are summed in sample order so that they do not depend on the thread count
+	map<unsigned int, pair<vector<unsigned int>, vector<vector<unsigned int> > > > pending;
+	unsigned int nextMerge; //next sample to add to pvalues
+
+	//one null distribution per minimum stem length in thresholds
+	vector<vector<double> > pvalues;
+	vector<vector<unsigned int> > lowerHelixCount;
+	vector<unsigned int> nullHelixCount;
+
+	//likelihoods of the randomized alignments that had to be rescaled
+	unsigned long pairsRescaled;
+	unsigned long columnsRescaled;
+};
+
+static void * nullSamplerThread(void * arg){
+	NullSampler * sampler = (NullSampler *)arg;
+
+	//the tree is shared: likelihoods are calculated in each randomized alignment's own workspace
+	Tree & tree = *sampler->tree;
+
+	unsigned int thresholdCount = sampler->thresholds->size();
+	vector<vector<unsigned int> > lowerHelixCount(thresholdCount, vector<unsigned int>(sampler->logLikeRatios->size(), 0));
+	vector<unsigned int> nullHelixCount(thresholdCount, 0);
+	unsigned long pairsRescaled = 0;
+	unsigned long columnsRescaled = 0;
+
+	while(true){
+		pthread_mutex_lock(&sampler->lock);
+		unsigned int sample = sampler->nextSample++;
+		pthread_mutex_unlock(&sampler->lock);
+
+		if(sample >= sampler->seeds->size()){
+			break;
+		}
 
-HelixFinder::HelixFinder(Alignment * a) : alignment(a){
-}
-
-HelixFinder::~HelixFinder() {
-
-}
-
-void HelixFinder::findAllHelices(){
-
-	//at this point, store helices in bins according to their outer base-pair
-	vector<list<AlignedHelix> > helicesByOuterBP;
+		vector<unsigned int> sampleSizes;
+		vector<vector<unsigned int> > lowerBounds;
+		HelixFinder::nullSample(*sampler->startingAlignment, tree, sampler->seeds->at(sample),
+				*sampler->logLikeRatios, *sampler->thresholds, sampleSizes, lowerBounds,
+				pairsRescaled, columnsRescaled, sampler->likelihoods);
 
-	//initialize storage container
-	for(unsigned int i = 0; i < alignment->alignedStruct.size() - 1; i++){
-		for(unsigned int j = i + 1; j < alignment->alignedStruct.size(); j++){
-			helicesByOuterBP.push_back(list<AlignedHelix>());
-			assert(convert(i,j) == (int)helicesByOuterBP.size()- 1);
+		for(unsigned int t = 0; t < thresholdCount; t++){
+			for(unsigned int j = 0; j < lowerBounds[t].size(); j++){
+				lowerHelixCount[t][j] += lowerBounds[t][j];
+			}
+			nullHelixCount[t] += sampleSizes[t];
 		}
-	}
 
-	//find helices in all sequences
-	for(unsigned int i = 0; i < alignment->alignedSeqs.size(); i++){
-		findAllHelices(i, helicesByOuterBP);
+		pthread_mutex_lock(&sampler->lock);
+		sampler->pending[sample].first.swap(sampleSizes);
+		sampler->pending[sample].second.swap(lowerBounds);
+
+		map<unsigned int, pair<vector<unsigned int>, vector<vector<unsigned int> > > >::iterator it;
+		while((it = sampler->pending.find(sampler->nextMerge)) != sampler->pending.end()){
+			for(unsigned int t = 0; t < thresholdCount; t++){
+				//if empty, implicitly add 0 to each pvalue
+				if(it->second.first[t] > 0){
+					vector<double> & pvalues = sampler->pvalues[t];
+					for(unsigned int j = 0; j < pvalues.size(); j++){
+						pvalues[j] += 1 - it->second.second[t][j]/(double) it->second.first[t];
+					}
+				}
+			}
+			sampler->pending.erase(it);
+			sampler->nextMerge++;
+		}
+		pthread_mutex_unlock(&sampler->lock);
 	}
 
-	//store all helices found:
-	for(unsigned int j = 0; j < helicesByOuterBP.size(); j++){
-		for(list<AlignedHelix>::iterator i = helicesByOuterBP[j].begin(); i != helicesByOuterBP[j].end(); i++){
-			//cout << i->dotBracket(alignment->alignedStruct.size()) << "\t" << j << endl;
-			helices.push_back(*i);
+	pthread_mutex_lock(&sampler->lock);
+	for(unsigned int t = 0; t < thresholdCount; t++){
+		for(unsigned int j = 0; j < lowerHelixCount[t].size(); j++){
+			sampler->lowerHelixCount[t][j] += lowerHelixCount[t][j];
 		}
+		sampler->nullHelixCount[t] += nullHelixCount[t];
 	}
+	sampler->pairsRescaled += pairsRescaled;
+	sampler->columnsRescaled += columnsRescaled;
+	pthread_mutex_unlock(&sampler->lock);
 
+	return NULL;
 }
 
-void HelixFinder::findAllHelices(int seqIndex, vector<list<AlignedHelix> > & helicesByOuterBP){
-
-	int **DP;
-	int i, j;
-
-	//double eStack[4][4][4][4];
-	//Utilities::ReadStack(eStack);
-
-	string Seq = *(alignment->seqs[seqIndex]);
-	int iL = Seq.length();
+/**
+ * the sequences searched by one worker thread of findAllHelices, and the helices found in them
+ */
+struct HelixSearch {
+	HelixFinder * finder;
+	int firstSeq;
+	int lastSeq; //exclusive
+	AlignedHelixSet found;
+};
+
+HelixFinder::HelixFinder(Alignment * a) : columnOffset(0), maxColumnSpan(INT_MAX), alignment(a){
+}
 
-	vector<int> P = *(alignment->seqStructs[seqIndex]);
-	// Initialize values
+HelixFinder::~HelixFinder() {
 
-	// allocate and initialize memory for dynamic programming
+}
 
-	DP = (int**) malloc(sizeof(int*) * iL);
-	for (i = 0; i < iL; i++) {
-		DP[i] = (int*) malloc(sizeof(int) * iL);
+void HelixFinder::printNullStats(){
+	if(nullPatterns == 0){
+		return;
 	}
+	cerr << "column patterns: " << nullPatterns << " distinct of " << nullColumns
+			<< " columns (compression ratio " << (double)nullColumns / nullPatterns << ")\n";
+	cerr << "column likelihood cache: " << likelihoodHits << " of " << likelihoodLookups << " lookups reused\n";
+}
 
-	for (i = 0; i < iL; i++) {
-		for (j = 0; j < iL; j++) {
-			DP[i][j] = 0;
-		}
-	}
+void HelixFinder::addRescaled(const FelsWorkspace & ws){
+	pairsRescaled += ws.felsDoubleRescaled;
+	columnsRescaled += ws.felsSingleRescaled;
+}
 
-	// dynamic programming
+void HelixFinder::printRescaled(){
+	cerr << "likelihoods rescaled to avoid underflow, over the input and null alignments: "
+			<< pairsRescaled << " column pair evaluations, " << columnsRescaled << " column evaluations\n";
+}
 
-	for (j = MIN_DIST; j < iL; j++) {
-		for (i = j - MIN_DIST; i >= 0; i--) {
+void HelixFinder::findAllHelices(int workers){
 
-			assert(i>= 0 && i < iL-MIN_DIST+1);
+	int seqCount = alignment->alignedSeqs.size();
+	workers = max(1, min(workers, seqCount));
 
-			if ((Seq[i] == 'A' && Seq[j] == 'U') || (Seq[i] == 'U' && Seq[j] == 'A') || (Seq[i] == 'C' && Seq[j] == 'G') || (Seq[i] == 'G' && Seq[j] == 'C') || (Seq[i] == 'G' && Seq[j] == 'U') || (Seq[i] == 'U' && Seq[j] == 'G')) {
-				assert(i+1 < iL-MIN_DIST+1);
-				DP[i][j] = DP[i + 1][j - 1] + 1;
-			} else {
-				DP[i][j] = 0;
+	//each worker searches a contiguous range of sequences
+	vector<HelixSearch> searches(workers);
+	for(int i = 0; i < workers; i++){
+		searches[i].finder = this;
+		searches[i].firstSeq = (long)seqCount * i / workers;
+		searches[i].lastSeq = (long)seqCount * (i + 1) / workers;
+	}
+
+	if(workers == 1){
+		helixSearchThread(&searches[0]);
+	}
+	else{
+		vector<pthread_t> workerThreads(workers);
+		for(int i = 0; i < workers; i++){
+			if(pthread_create(&workerThreads[i], NULL, helixSearchThread, &searches[i]) != 0){
+				cerr << "Error: could not create worker thread\n";
+				exit(-1);
 			}
+		}
+		for(int i = 0; i < workers; i++){
+			pthread_join(workerThreads[i], NULL);
+		}
+	}
 
-			if ((DP[i][j] == 0) && (DP[i + 1][j - 1] > Alignment::minStemLength)) {
+	//merging in sequence order gives the same helices, in the same order, as a serial search
+	AlignedHelixSet & found = searches[0].found;
+	for(int i = 1; i < workers; i++){
+		found.merge(searches[i].found);
+	}
 
-				//found a helix:
-				Helix h(i+1, j-1, DP[i+1][j-1]);
-				int loc = convert(alignment->seq2AlignmentMap[seqIndex]->at(i+1), alignment->seq2AlignmentMap[seqIndex]->at(j-1));
+	//store all helices found:
+	found.takeSortedHelices(helices);
 
-				//try to insert it into existing helices;
-				bool found = false;
-				for(list<AlignedHelix>::iterator it = helicesByOuterBP[loc].begin(); it != helicesByOuterBP[loc].end(); it++){
-					found = it->insert(h, seqIndex, *alignment->seq2AlignmentMap[seqIndex]);
-					if(found){
-						break;
-					}
-				}
+}
 
-				//not found -> create new AlignedHelix and add it in
-				if(!found){
-					AlignedHelix alignedH(h, seqIndex, *alignment->seq2AlignmentMap[seqIndex]);
-					helicesByOuterBP[loc].push_back(alignedH);
-				}
+void * HelixFinder::helixSearchThread(void * arg){
+	HelixSearch * search = (HelixSearch *)arg;
 
-			}
-		}
+	for(int i = search->firstSeq; i < search->lastSeq; i++){
+		search->finder->findAllHelices(i, search->found);
 	}
 
-	//find helices on edges of matrix
-	for(j = 0; j < iL; j++){
+	return NULL;
+}
 
-		if (DP[0][j] > Alignment::minStemLength){
-			//found a helix:
-			Helix h(0, j, DP[0][j]);
-			int loc = convert(alignment->seq2AlignmentMap[seqIndex]->at(0), alignment->seq2AlignmentMap[seqIndex]->at(j));
+void HelixFinder::findAllHelices(int seqIndex, AlignedHelixSet & found){
 
-			//try to insert it into existing helices;
-			bool found = false;
-			for(list<AlignedHelix>::iterator it = helicesByOuterBP[loc].begin(); it != helicesByOuterBP[loc].end(); it++){
-				found = it->insert(h, seqIndex, *alignment->seq2AlignmentMap[seqIndex]);
-				if(found){
-					break;
-				}
-			}
-
-			//not found -> create new AlignedHelix and add it in
-			if(!found){
-				AlignedHelix alignedH(h, seqIndex, *alignment->seq2AlignmentMap[seqIndex]);
-				helicesByOuterBP[loc].push_back(alignedH);
-			}
+	const vector<Helix> & stems = alignment->sequenceStems(seqIndex);
+	vector<int> & seq2AlignmentMap = *alignment->seq2AlignmentMap[seqIndex];
 
+	for(unsigned int i = 0; i < stems.size(); i++){
+		if(continuesOutside(stems[i], seqIndex)){
+			continue;
 		}
-
-		if (DP[j][iL-1] > Alignment::minStemLength && j != 0){ //the j==0 case is caught by the above condition (when j = iL-1)
-			//found a helix:
-			Helix h(j, iL-1, DP[j][iL-1]);
-			int loc = convert(alignment->seq2AlignmentMap[seqIndex]->at(j), alignment->seq2AlignmentMap[seqIndex]->at(iL-1));
-
-			//try to insert it into existing helices;
-			bool found = false;
-			for(list<AlignedHelix>::iterator it = helicesByOuterBP[loc].begin(); it != helicesByOuterBP[loc].end(); it++){
-				found = it->insert(h, seqIndex, *alignment->seq2AlignmentMap[seqIndex]);
-				if(found){
-					break;
-				}
-			}
-
-			//not found -> create new AlignedHelix and add it in
-			if(!found){
-				AlignedHelix alignedH(h, seqIndex, *alignment->seq2AlignmentMap[seqIndex]);
-				helicesByOuterBP[loc].push_back(alignedH);
-			}
+		if(seq2AlignmentMap[stems[i].pos3] - seq2AlignmentMap[stems[i].pos5] > maxColumnSpan){
+			continue;
 		}
+		found.add(stems[i], seqIndex, seq2AlignmentMap);
+	}
+}
 
+bool HelixFinder::continuesOutside(const Helix & h, int seqIndex){
+	if(basesBefore.empty()){
+		return false;
 	}
 
-	for (i = 0; i < iL; i++) {
-		free(DP[i]);
+	//the pair outside the outer pair of h, at positions pos5 < 0 or pos3 >= length if outside the window
+	const string & seq = *alignment->seqs[seqIndex];
+	int pos5 = h.pos5 - 1;
+	int pos3 = h.pos3 + 1;
+	if(pos5 >= 0 && pos3 < (int)seq.length()){
+		//inside the window, so the stem is maximal
+		return false;
 	}
-	free(DP);
 
-	return;
+	char base5 = (pos5 >= 0) ? seq[pos5] : basesBefore[seqIndex];
+	char base3 = (pos3 < (int)seq.length()) ? seq[pos3] : basesAfter[seqIndex];
+	if(pos3 - pos5 > Alignment::maxSpan){
+		return false;
+	}
+	return base5 == '?' || base3 == '?' || StemFinder::canPair(base5, base3);
 }
 
-int HelixFinder::convert(int pos5, int pos3){
-	return pos5 * alignment->alignedStruct.size() + pos3 - ((pos5+2)*(pos5+1))/2;
+bool HelixFinder::reachesWindowEnd(int seqIndex){
+	const vector<Helix> & stems = alignment->sequenceStems(seqIndex);
+	int end = alignment->seqs[seqIndex]->length();
+	for(unsigned int i = 0; i < stems.size(); i++){
+		if(stems[i].pos3 + 1 == end && end - (stems[i].pos5 - 1) <= Alignment::maxSpan){
+			return true;
+		}
+	}
+	return false;
 }
 
 void HelixFinder::allHelicesPvalueTable(int randomSamples, Tree & tree, bool doPvalues){
 
 	assert(randomSamples > 0);
-	cout << "Pvalue\tLogLikeRatio\tPairedLogLikelihood\tUnpairedLogLikelihood\tMeanFracCanonicalBP\tCovariance\tConservation\tLength\tMidpoint\tNormalizedMidpoint\tAppearances\tIsConsensusHelix\tIsPartialConsensusHelix\tIsCompetingHelix\tConsensusBps\tStructure"
-	<< "\tAlignmentSize\tAlignmentLength\tTreeLength\tBps"
-	<< "\tCis\tTrans"
-	<< "\tCis5\tCis3\tTrans5\tTrans3\tMid5\tMid3"
-	<< "\tnewPvalue"
-	<< endl;
+	if(Alignment::printHeaders){
+		cout << "Pvalue\tLogLikeRatio\tPairedLogLikelihood\tUnpairedLogLikelihood\tMeanFracCanonicalBP\tCovariance\tConservation\tLength\tMidpoint\tNormalizedMidpoint\tAppearances\tIsConsensusHelix\tIsPartialConsensusHelix\tIsCompetingHelix\tConsensusBps\tStructure"
+		<< "\tAlignmentSize\tAlignmentLength\tTreeLength\tBps"
+		<< "\tCis\tTrans"
+		<< "\tCis5\tCis3\tTrans5\tTrans3\tMid5\tMid3"
+		<< "\tnewPvalue";
+		if(!minStemLengths.empty()){
+			cout << "\tMinSL";
+		}
+		cout << endl;
+	}
 
 	if(helices.empty()){
 		cerr << "No helices found - Pvalue Table empty\n";
 		return;
 	}
 
+	//one table per minimum stem length: the helices longer than it, with pvalues from the
+	//null helices longer than it. All are found with the smallest, Alignment::minStemLength
+	vector<int> thresholds(minStemLengths);
+	if(thresholds.empty()){
+		thresholds.push_back(Alignment::minStemLength);
+	}
+
 	//initialize pvalues
-	vector<double> pvalues(helices.size(), 0.0);
-	vector<double> newPvalues(helices.size(), 0.0);
-	vector<unsigned int> lowerHelixCount(helices.size(), 0);
-	unsigned int nullHelixCount = 0;
-	vector<double> randLogLikes;
+	vector<vector<double> > pvalues(thresholds.size(), vector<double>(helices.size(), 0.0));
+	vector<vector<double> > newPvalues(thresholds.size(), vector<double>(helices.size(), 0.0));
+	vector<vector<unsigned int> > lowerHelixCount(thresholds.size(), vector<unsigned int>(helices.size(), 0));
+	vector<unsigned int> nullHelixCount(thresholds.size(), 0);
 	//if we don't do p value calculation, p-value column will be all zeros
 
 	Alignment * startingAlignment;
@@ -218,91 +316,181 @@ void HelixFinder::allHelicesPvalueTable(int randomSamples, Tree & tree, bool doP
 		startingAlignment = alignment;
 	}
 
+	//the log ratios are needed for the pvalues, and decide which helices are printed before
+	//their other columns are calculated
+	vector<double> logLikeRatios(helices.size());
+	for(unsigned int j = 0; j < helices.size(); j++){
+		logLikeRatios[j] = helices[j].logLikeRatio(*alignment, tree);
+	}
+
 	if(doPvalues){
+		//one seed per sample, drawn up front so that samples do not depend on
+		//which thread generates them
+		vector<unsigned int> seeds(randomSamples);
 		for(int i = 0; i < randomSamples; i++){
+			seeds[i] = rand();
+		}
 
-
-			ShuffledAlignment randomizedAlignment(*startingAlignment);
-			HelixFinder randomHelices(&randomizedAlignment);
-
-			randomHelices.findAllHelices();
-			for(unsigned int j = 0; j < randomHelices.helices.size(); j++){
-				randLogLikes.push_back(randomHelices.helices[j].logLikeRatio(randomizedAlignment, tree));
-			}
-
-			sort(randLogLikes.begin(), randLogLikes.end());
-
-			if(!randLogLikes.empty()){
-				int lowerbound;
-				for(unsigned int j = 0; j < pvalues.size(); j++){
-					lowerbound = Utilities::lowerBound(randLogLikes, 0, randLogLikes.size(), helices[j].logLikeRatio(*alignment, tree));
-					lowerHelixCount[j] += lowerbound;
-					pvalues[j] += 1 - lowerbound/(double) randLogLikes.size();
+		//shuffled alignments are made of the starting alignment's columns: share their likelihoods
+		ColumnLikelihoodCache likelihoods(startingAlignment->patternCount, tree);
+
+		NullSampler sampler;
+		sampler.startingAlignment = startingAlignment;
+		sampler.tree = &tree;
+		sampler.seeds = &seeds;
+		sampler.logLikeRatios = &logLikeRatios;
+		sampler.thresholds = &thresholds;
+		sampler.likelihoods = &likelihoods;
+		pthread_mutex_init(&sampler.lock, NULL);
+		sampler.nextSample = 0;
+		sampler.nextMerge = 0;
+		sampler.pairsRescaled = 0;
+		sampler.columnsRescaled = 0;
+		sampler.pvalues.swap(pvalues);
+		sampler.lowerHelixCount.swap(lowerHelixCount);
+		sampler.nullHelixCount.swap(nullHelixCount);
+
+		int workers = max(1, min(threads, randomSamples));
+		if(workers == 1){
+			nullSamplerThread(&sampler);
+		}
+		else{
+			vector<pthread_t> workerThreads(workers);
+			for(int i = 0; i < workers; i++){
+				if(pthread_create(&workerThreads[i], NULL, nullSamplerThread, &sampler) != 0){
+					cerr << "Error: could not create worker thread\n";
+					exit(-1);
 				}
 			}
-			//if empty, implicitly add 0 to each pvalue
+			for(int i = 0; i < workers; i++){
+				pthread_join(workerThreads[i], NULL);
+			}
+		}
+		pthread_mutex_destroy(&sampler.lock);
 
-			nullHelixCount += randLogLikes.size();
+		nullColumns += startingAlignment->alignedStruct.size();
+		nullPatterns += startingAlignment->patternCount;
+		likelihoodLookups += likelihoods.lookups();
+		likelihoodHits += likelihoods.hits();
+		pairsRescaled += sampler.pairsRescaled;
+		columnsRescaled += sampler.columnsRescaled;
 
-			randLogLikes.clear();
-		}
+		assert(sampler.pending.empty());
+		pvalues.swap(sampler.pvalues);
+		lowerHelixCount.swap(sampler.lowerHelixCount);
+		nullHelixCount.swap(sampler.nullHelixCount);
 
 		//take average over all samples
-		assert(nullHelixCount >0);
-		for(unsigned int j = 0 ; j < pvalues.size(); j++){
-			newPvalues[j] = 1 - lowerHelixCount[j] / (double)nullHelixCount;
-			pvalues[j] = pvalues[j] / randomSamples;
+		for(unsigned int t = 0; t < thresholds.size(); t++){
+			assert(nullHelixCount[t] >0);
+			for(unsigned int j = 0 ; j < helices.size(); j++){
+				newPvalues[t][j] = 1 - lowerHelixCount[t][j] / (double)nullHelixCount[t];
+				pvalues[t][j] = pvalues[t][j] / randomSamples;
+			}
 		}
 	}
 
 	double treeLength = tree.totalLength();
 
-	for(unsigned int j = 0; j < helices.size(); j++){
-//		cout << helices[j].isConsensusHelix(*alignment) << "\t";
-		cout << pvalues[j] << "\t";
-		cout << helices[j].logLikeRatio(*alignment, tree) << "\t";
-		cout << helices[j].pairedLikelihood(*alignment, tree) << "\t";
-		cout << helices[j].unpairdLikelihood(*alignment, tree) << "\t";
-		cout << helices[j].canonicalBP(*alignment) << "\t";
-		cout << helices[j].covariance(*alignment) << "\t";
-		cout << helices[j].conservation(*alignment) << "\t";
-		cout << helices[j].length() << "\t";
-		cout << helices[j].midpoint() << "\t";
-		cout << helices[j].midpoint(*alignment) << "\t";
-		cout << helices[j].appearances() << "\t";
-		cout << helices[j].isConsensusHelix(*alignment) << "\t";
-		cout << helices[j].isPartialConsensusHelix(*alignment) << "\t";
-		cout << helices[j].isCompetingHelix(*alignment) << "\t";
-		cout << helices[j].consensusBps(*alignment) << "\t";
-		if(verbose_out){
-			cout << helices[j].dotBracket(alignment->alignedStruct.size());
-		}
-		else{
-			cout << 0;
+	for(unsigned int t = 0; t < thresholds.size(); t++){
+		for(unsigned int j = 0; j < helices.size(); j++){
+			if(helices[j].length() <= thresholds[t] || logLikeRatios[j] < minLogLikeRatio || pvalues[t][j] > maxPvalue){
+				continue;
+			}
+//			cout << helices[j].isConsensusHelix(*alignment) << "\t";
+			cout << pvalues[t][j] << "\t";
+			double paired, unpaired, logLikeRatio;
+			helices[j].likelihoods(*alignment, tree, paired, unpaired, logLikeRatio);
+			cout << logLikeRatio << "\t";
+			cout << paired << "\t";
+			cout << unpaired << "\t";
+			cout << helices[j].canonicalBP(*alignment) << "\t";
+			cout << helices[j].covariance(*alignment) << "\t";
+			cout << helices[j].conservation(*alignment) << "\t";
+			cout << helices[j].length() << "\t";
+			cout << helices[j].midpoint() + columnOffset << "\t";
+			cout << helices[j].midpoint(*alignment) << "\t";
+			cout << helices[j].appearances() << "\t";
+			cout << helices[j].isConsensusHelix(*alignment) << "\t";
+			cout << helices[j].isPartialConsensusHelix(*alignment) << "\t";
+			cout << helices[j].isCompetingHelix(*alignment) << "\t";
+			cout << helices[j].consensusBps(*alignment) << "\t";
+			if(verbose_out){
+				cout << helices[j].dotBracket(alignment->alignedStruct.size());
+			}
+			else{
+				cout << 0;
+			}
+			cout << "\t" << alignment->seqs.size();
+			cout << "\t" << alignment->alignedStruct.size();
+			cout << "\t" << treeLength;
+			cout << "\t" << helices[j].bpsString(columnOffset);
+
+			pair<double, double> cisTrans = helices[j].cisTransScore(*alignment);
+			cout << "\t" << cisTrans.first;
+			cout << "\t" << cisTrans.second;
+
+			double cis5, cis3, trans5, trans3, mid5, mid3;
+			helices[j].competeScore(*alignment, cis5, cis3, trans5, trans3, mid5, mid3);
+			cout << "\t" << cis5;
+			cout << "\t" << cis3;
+			cout << "\t" << trans5;
+			cout << "\t" << trans3;
+			cout << "\t" << mid5;
+			cout << "\t" << mid3;
+
+			cout << "\t" << newPvalues[t][j];
+			if(!minStemLengths.empty()){
+				cout << "\t" << thresholds[t];
+			}
+
+			cout << endl;
 		}
-		cout << "\t" << alignment->seqs.size();
-		cout << "\t" << alignment->alignedStruct.size();
-		cout << "\t" << treeLength;
-		cout << "\t" << helices[j].bpsString();
-
-		pair<double, double> cisTrans = helices[j].cisTransScore(*alignment);
-		cout << "\t" << cisTrans.first;
-		cout << "\t" << cisTrans.second;
-
-		double cis5, cis3, trans5, trans3, mid5, mid3;
-		helices[j].competeScore(*alignment, cis5, cis3, trans5, trans3, mid5, mid3);
-		cout << "\t" << cis5;
-		cout << "\t" << cis3;
-		cout << "\t" << trans5;
-		cout << "\t" << trans3;
-		cout << "\t" << mid5;
-		cout << "\t" << mid3;
-
-		cout << "\t" << newPvalues[j];
+	}
 
-		cout << endl;
+}
+
+void HelixFinder::nullSample(Alignment & startingAlignment, Tree & tree, unsigned int seed,
+		const vector<double> & logLikeRatios, const vector<int> & thresholds,
+		vector<unsigned int> & sampleSizes, vector<vector<unsigned int> > & lowerBounds,
+		unsigned long & rescaledPairs, unsigned long & rescaledColumns,
+		ColumnLikelihoodCache * cache){
+
+	ShuffledAlignment randomizedAlignment(startingAlignment, &seed);
+	randomizedAlignment.shareLikelihoods(cache);
+	HelixFinder randomHelices(&randomizedAlignment);
+
+	randomHelices.findAllHelices();
+
+	//log ratio and length of each null helix, sorted by log ratio
+	vector<pair<double, int> > randHelices;
+	for(unsigned int j = 0; j < randomHelices.helices.size(); j++){
+		randHelices.push_back(make_pair(randomHelices.helices[j].logLikeRatio(randomizedAlignment, tree),
+				randomHelices.helices[j].length()));
 	}
 
+	sort(randHelices.begin(), randHelices.end());
+	rescaledPairs += randomizedAlignment.felsWorkspace.felsDoubleRescaled;
+	rescaledColumns += randomizedAlignment.felsWorkspace.felsSingleRescaled;
+
+	sampleSizes.assign(thresholds.size(), 0);
+	lowerBounds.assign(thresholds.size(), vector<unsigned int>(logLikeRatios.size(), 0));
+	vector<double> randLogLikes;
+	for(unsigned int t = 0; t < thresholds.size(); t++){
+		randLogLikes.clear();
+		for(unsigned int j = 0; j < randHelices.size(); j++){
+			if(randHelices[j].second > thresholds[t]){
+				randLogLikes.push_back(randHelices[j].first);
+			}
+		}
+
+		sampleSizes[t] = randLogLikes.size();
+		if(!randLogLikes.empty()){
+			for(unsigned int j = 0; j < logLikeRatios.size(); j++){
+				lowerBounds[t][j] = Utilities::lowerBound(randLogLikes, 0, randLogLikes.size(), logLikeRatios[j]);
+			}
+		}
+	}
 }
 
 void HelixFinder::balancedSparseHelixTable(Tree & tree){
@@ -368,16 +556,17 @@ void HelixFinder::coverage(double & coverage, double & exactMatchCoverage, doubl
 
 	for(unsigned int i = 0 ; i < helices.size(); i++){
 		if(helices[i].isConsensusHelix(*alignment)){
-			for(unsigned int j = 0; j < helices[i].bps.size(); j++){
-				exactCovered[helices[i].bps[j].first] = true;
-				exactCovered[helices[i].bps[j].second] = true;
+			for(int j = 0; j < helices[i].length(); j++){
+				exactCovered[helices[i].bp(j).first] = true;
+				exactCovered[helices[i].bp(j).second] = true;
 			}
 		}
 		if(helices[i].consensusBps(*alignment) / (double) helices[i].length() > trueHelixCutoff || (trueHelixCutoff == 1.0 && helices[i].consensusBps(*alignment) == (int)helices[i].length()) ){
-			for(unsigned int j = 0; j < helices[i].bps.size(); j++){
-				if(alignment->alignedStruct[helices[i].bps[j].first] == helices[i].bps[j].second){
-					covered[helices[i].bps[j].first] = true;
-					covered[helices[i].bps[j].second] = true;
+			for(int j = 0; j < helices[i].length(); j++){
+				pair<int, int> bp = helices[i].bp(j);
+				if(alignment->alignedStruct[bp.first] == bp.second){
+					covered[bp.first] = true;
+					covered[bp.second] = true;
 				}
 			}
 		}
@@ -424,9 +613,12 @@ void HelixFinder::findAllHelicesGrow(Tree & tree, double seedThreshold, double g
 //	list<pair<int, int> > innerGrow;
 	list<pair<int, int> > growPoints;
 
+	//every pair at least MIN_DIST apart is scored at least once below
+	alignment->fillLikelihoodTables(tree, MIN_DIST);
+
 	//find seed points
 	for(int i = 0; i < alignmentLength-MIN_DIST; i++){
-		for(int j = i + MIN_DIST; j < alignmentLength; j++){
+		for(int j = i + MIN_DIST; j < alignmentLength && j - i <= Alignment::maxSpan; j++){
 			if(alignment->logLikelihood(i,j, tree) / treeLength > seedThreshold){
 				partOfHelix[i][j-i] = true;
 //				if(i > 0 && j+1 < alignment->alignedStruct.size()){
@@ -447,7 +639,8 @@ void HelixFinder::findAllHelicesGrow(Tree & tree, double seedThreshold, double g
 	while(!growPoints.empty()){
 		current = growPoints.front();
 		//outer bp growth:
-		if(current.first > 0 && current.second + 1 < alignmentLength){
+		if(current.first > 0 && current.second + 1 < alignmentLength
+				&& current.second - current.first <= Alignment::maxSpan - 2){
 			candidate = pair<int,int>(current.first -1, current.second +1);
 			if(!partOfHelix[candidate.first][candidate.second - candidate.first] && alignment->logLikelihood(candidate.first, candidate.second , tree) / treeLength > growThreshold){
 				partOfHelix[candidate.first][candidate.second - candidate.first] = true;
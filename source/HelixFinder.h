@@ -12,7 +12,9 @@
 #include <vector>
 #include <list>
 #include "AlignedHelix.h"
+#include "AlignedHelixSet.h"
 #include "Tree.h"
+#include "ColumnLikelihoodCache.h"
 
 using namespace std;
 
@@ -25,7 +27,11 @@ public:
 	HelixFinder(Alignment * alignment_);
 	virtual ~HelixFinder();
 
-	void findAllHelices();
+	/**
+	 * finds the helices of all sequences; sequences are divided among worker threads.
+	 * The helices found do not depend on the number of workers.
+	 */
+	void findAllHelices(int workers = 1);
 
 	void findAllHelicesGrow(Tree & tree, double seedThreshold, double growThreshold);
 
@@ -52,6 +58,22 @@ public:
 	 */
 	void allHelicesPvalueTable(int randomSamples, Tree & tree, bool doPvalues=true);
 
+	/**
+	 * generates one randomized alignment of startingAlignment (shuffled with the given seed)
+	 * and finds all of its helices.
+	 * For each minimum stem length thresholds[t], sampleSizes[t] is set to the number of null
+	 * helices longer than it, and lowerBounds[t][j] to the number of those with a log ratio
+	 * lower than logLikeRatios[j].
+	 * Column likelihoods are looked up in (and added to) cache, which belongs to startingAlignment.
+	 * The likelihoods of the randomized alignment that had to be rescaled are added to
+	 * rescaledPairs and rescaledColumns.
+	 */
+	static void nullSample(Alignment & startingAlignment, Tree & tree, unsigned int seed,
+			const vector<double> & logLikeRatios, const vector<int> & thresholds,
+			vector<unsigned int> & sampleSizes, vector<vector<unsigned int> > & lowerBounds,
+			unsigned long & rescaledPairs, unsigned long & rescaledColumns,
+			ColumnLikelihoodCache * cache = NULL);
+
 	void balancedSparseHelixTable(Tree & tree);
 
 	void sparseHelixTable(Tree & tree);
@@ -72,6 +94,89 @@ public:
 	static Realigner realign;
 	static bool verbose_out;
 
+	/**
+	 * number of worker threads used to find the helices of the alignment and to generate
+	 * the null distribution (default = 1)
+	 */
+	static int threads;
+
+	/**
+	 * minimum stem lengths of a -minSL sweep. Helices are found once, with the smallest
+	 * (Alignment::minStemLength), and the pvalue table is printed for each length in turn,
+	 * with its own null distribution and a MinSL column. Empty if there is no sweep (default)
+	 */
+	static vector<int> minStemLengths;
+
+	/**
+	 * helices with a lower log ratio, or a higher pvalue, are left out of the pvalue table, and
+	 * their other columns are not calculated (defaults: no limit)
+	 */
+	static double minLogLikeRatio;
+	static double maxPvalue;
+
+	/**
+	 * totals over all null distributions generated so far (one per pvalue table, i.e. per
+	 * window in -maf mode): columns and distinct column patterns of the starting alignments,
+	 * and lookups in their column likelihood caches, of which hits were reused
+	 */
+	static long nullColumns;
+	static long nullPatterns;
+	static unsigned long likelihoodLookups;
+	static unsigned long likelihoodHits;
+
+	/**
+	 * prints the totals above to stderr, if any null distribution was generated
+	 */
+	static void printNullStats();
+
+	/**
+	 * likelihoods of column pairs (resp. columns) that had to be rescaled to avoid underflow
+	 * (see FelsWorkspace), summed over the input alignment (or its windows) and every null
+	 * sample. These count evaluations: a column pair is counted each time it is calculated
+	 */
+	static unsigned long pairsRescaled;
+	static unsigned long columnsRescaled;
+
+	/**
+	 * adds the rescaling counts of ws to the totals above (not thread-safe)
+	 */
+	static void addRescaled(const FelsWorkspace & ws);
+
+	/**
+	 * prints the totals above to stderr
+	 */
+	static void printRescaled();
+
+	/**
+	 * column of a larger alignment at which the alignment starts (see WindowScanner).
+	 * Added to the positions in the pvalue table (default = 0)
+	 */
+	long columnOffset;
+
+	/**
+	 * if the alignment is a window of a larger alignment (see WindowScanner): for each
+	 * sequence, the bases just before and just after the window ('\0' if there are none,
+	 * '?' if unknown). Stems that continue, or may continue, outside the window are left
+	 * out, as they are found whole in another window. Empty if the alignment is not a
+	 * window (default)
+	 */
+	vector<char> basesBefore;
+	vector<char> basesAfter;
+
+	/**
+	 * true if a stem of sequence seqIndex ends at the last base of the window and the base
+	 * after the window is close enough (within Alignment::maxSpan) to extend it, i.e. if
+	 * basesAfter[seqIndex] decides whether the stem is left out
+	 */
+	bool reachesWindowEnd(int seqIndex);
+
+	/**
+	 * helices whose outer pair is more than this many columns apart are left out. The
+	 * span limit of the stems (Alignment::maxSpan) counts sequence positions, so a gapped
+	 * helix can span more columns than that (default: no limit)
+	 */
+	int maxColumnSpan;
+
 
 private:
 	Alignment * alignment; //reference instead of pointer?
@@ -83,16 +188,16 @@ private:
 
 	/**
 	 * find all helices in a specific sequence from the alignment
-	 * (not added to helices vector, just to helicesByOuterBP vector)
+	 * (not added to helices vector, just to found)
 	 */
-	void findAllHelices(int seqIndex, vector<list<AlignedHelix> > & helicesByOuterBP);
+	void findAllHelices(int seqIndex, AlignedHelixSet & found);
+
+	static void * helixSearchThread(void * arg);
 
 	/**
-	 * converts a pair of positions to an index in a flattened UT matrix, as used in helicesByOuterBP
+	 * true if stem h of sequence seqIndex continues outside the window (see basesBefore)
 	 */
-	int convert(int pos5, int pos3);
-
-	void clearDuplicates(vector<list<AlignedHelix> > & helicesByOuterBP);
+	bool continuesOutside(const Helix & h, int seqIndex);
 };
 
 #endif /* HELIXFINDER_H_ */
@@ -0,0 +1,154 @@
+/*
+ * Copyright: Nicholas P Wiebe (2008-2009) and Irmtraud M Meyer (2008-2009)
+ * License: licensed under the GNU General Public License version 3 (GPLv3)
+ */
+
+#include "MafReader.h"
+#include "Utilities.h"
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <cctype>
+
+MafReader::MafReader(const string & filename, const vector<string> & species) : filename(filename), species(species) {
+	blockCount = 0;
+	ignoredRows = 0;
+	for(unsigned int i = 0; i < species.size(); i++){
+		speciesIndex[species[i]] = i;
+	}
+	seen.assign(species.size(), false);
+
+	maf.open(filename.c_str());
+	if(!maf.is_open()){
+		cerr << "Error: cannot open MAF file " << filename << endl;
+		exit(-1);
+	}
+}
+
+MafReader::~MafReader() {
+	maf.close();
+}
+
+int MafReader::speciesOf(const string & source){
+	//the whole source name, then without each '.' suffix in turn
+	size_t end = source.length();
+	while(end != string::npos && end > 0){
+		map<string, int>::iterator found = speciesIndex.find(source.substr(0, end));
+		if(found != speciesIndex.end()){
+			return found->second;
+		}
+		end = source.rfind('.', end - 1);
+	}
+	return -1;
+}
+
+void MafReader::checkSpecies(){
+	vector<string> missing;
+	for(unsigned int i = 0; i < species.size(); i++){
+		if(!seen[i]){
+			missing.push_back(species[i]);
+		}
+	}
+	if(missing.size() == species.size()){
+		cerr << "Error: none of the species of the tree has a row in MAF file " << filename
+				<< " (a row of species X has source name X or X.<sequence>)\n";
+		exit(-1);
+	}
+	if(!missing.empty()){
+		cerr << "Warning: " << missing.size() << " species of the tree have no row in MAF file " << filename
+				<< " and were read as gaps:";
+		for(unsigned int i = 0; i < missing.size(); i++){
+			cerr << " " << missing[i];
+		}
+		cerr << "\n";
+	}
+	if(ignoredRows > 0){
+		cerr << "Warning: " << ignoredRows << " rows of species not in the tree were ignored:";
+		for(set<string>::iterator it = ignoredSpecies.begin(); it != ignoredSpecies.end(); it++){
+			cerr << " " << *it;
+		}
+		cerr << "\n";
+	}
+}
+
+bool MafReader::readBlock(vector<string> & rows){
+	string line;
+
+	//find the start of the next block
+	bool inBlock = false;
+	while(!inBlock && getline(maf, line)){
+		inBlock = line.length() > 0 && line[0] == 'a';
+	}
+	if(!inBlock){
+		return false;
+	}
+
+	vector<string> blockRows(speciesIndex.size());
+	int width = -1;
+
+	//a block ends with a blank line
+	while(getline(maf, line)){
+		Utilities::TrimSpaces(line);
+		if(line.length() == 0){
+			break;
+		}
+		if(line[0] != 's'){
+			//i, e, q lines and comments
+			continue;
+		}
+
+		//s src start size strand srcSize text
+		istringstream fields(line);
+		string s, source, start, size, strand, sourceSize, text;
+		fields >> s >> source >> start >> size >> strand >> sourceSize >> text;
+		if(text.length() == 0){
+			cerr << "Error: malformed line in MAF file " << filename << ":\n" << line << endl;
+			exit(-1);
+		}
+		if(width < 0){
+			width = text.length();
+		}
+		else if(width != (int)text.length()){
+			cerr << "Error: rows of different lengths in block " << blockCount + 1 << " of MAF file " << filename << endl;
+			exit(-1);
+		}
+
+		int index = speciesOf(source);
+		if(index < 0){
+			ignoredRows++;
+			ignoredSpecies.insert(source.substr(0, source.find('.')));
+			continue;
+		}
+		if(blockRows[index].length() > 0){
+			continue;
+		}
+		seen[index] = true;
+
+		//convert to upper case, Ts to Us and '.' to gaps
+		for(unsigned int i = 0; i < text.length(); i++){
+			text[i] = toupper(text[i]);
+			if(text[i] == 'T'){
+				text[i] = 'U';
+			}
+			else if(text[i] == '.'){
+				text[i] = '-';
+			}
+		}
+		blockRows[index] = text;
+	}
+	blockCount++;
+
+	if(width < 0){
+		//empty block
+		return true;
+	}
+	for(unsigned int i = 0; i < rows.size(); i++){
+		if(blockRows[i].length() > 0){
+			rows[i] += blockRows[i];
+		}
+		else{
+			rows[i].append(width, '-');
+		}
+	}
+	return true;
+}
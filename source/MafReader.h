@@ -0,0 +1,80 @@
+/*
+ * Copyright: Nicholas P Wiebe (2008-2009) and Irmtraud M Meyer (2008-2009)
+ * License: licensed under the GNU General Public License version 3 (GPLv3)
+ * MafReader.h
+ *
+ * Reads a multiple alignment file in MAF format one alignment block at a time, so
+ * that whole-genome alignments can be scanned without loading them into memory.
+ * The rows of a block are matched to a fixed set of species: a row belongs to a
+ * species if its source name is the species name, or the species name followed by
+ * '.' and a sequence name (e.g. "hg19.chr1" for "hg19"). Species names may contain '.'
+ * themselves; the longest one that matches is used.
+ */
+
+#ifndef MAFREADER_H_
+#define MAFREADER_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <fstream>
+
+using namespace std;
+
+class MafReader {
+public:
+	/**
+	 * opens filename (exits with an error message if it cannot be opened)
+	 * @param species names of the species to read, in the order their rows are returned
+	 */
+	MafReader(const string & filename, const vector<string> & species);
+	virtual ~MafReader();
+
+	/**
+	 * appends the columns of the next alignment block to rows (one row per species).
+	 * Species without a row in the block get gaps; rows of other species, and all but
+	 * the first row of a species, are ignored. Bases are converted to upper case, Ts to
+	 * Us and '.' to gaps.
+	 * @return false if there are no more blocks
+	 */
+	bool readBlock(vector<string> & rows);
+
+	/**
+	 * number of blocks read so far
+	 */
+	int blockCount;
+
+	/**
+	 * to be called after reading: exits with an error if none of the species had a row
+	 * in any block (e.g. if the names of the tree do not match the file), and warns about
+	 * species without rows and about rows of other species, which were read as gaps
+	 * (resp. ignored)
+	 */
+	void checkSpecies();
+
+private:
+	ifstream maf;
+	string filename;
+	vector<string> species;
+	map<string, int> speciesIndex;
+
+	/**
+	 * for each species, whether it had a row in any block
+	 */
+	vector<bool> seen;
+
+	/**
+	 * rows ignored because their species is not one of the species to read, and the names
+	 * of those species
+	 */
+	long ignoredRows;
+	set<string> ignoredSpecies;
+
+	/**
+	 * index of the species of the row with this source name, -1 if none
+	 */
+	int speciesOf(const string & source);
+};
+
+#endif /* MAFREADER_H_ */
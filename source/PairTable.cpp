@@ -0,0 +1,68 @@
+/*
+ * Copyright: Nicholas P Wiebe (2008-2009) and Irmtraud M Meyer (2008-2009)
+ * License: licensed under the GNU General Public License version 3 (GPLv3)
+ */
+
+#include "PairTable.h"
+#include <cassert>
+#include <algorithm>
+
+PairTable::PairTable() : size(0), tilesPerRow(0), unknown(0){
+}
+
+PairTable::PairTable(const PairTable & other) : size(0), tilesPerRow(0), unknown(0){
+	*this = other;
+}
+
+PairTable & PairTable::operator=(const PairTable & other){
+	if(this != &other){
+		reset(other.size, other.unknown);
+		for(unsigned int t = 0; t < tiles.size(); t++){
+			if(other.tiles[t] != NULL){
+				tiles[t] = new double[TILE * TILE];
+				copy(other.tiles[t], other.tiles[t] + TILE * TILE, tiles[t]);
+			}
+		}
+	}
+	return *this;
+}
+
+PairTable::~PairTable() {
+	freeTiles();
+}
+
+void PairTable::freeTiles(){
+	for(unsigned int t = 0; t < tiles.size(); t++){
+		delete [] tiles[t];
+	}
+	tiles.clear();
+}
+
+void PairTable::reset(int size_, double unknown_){
+	freeTiles();
+	size = size_;
+	unknown = unknown_;
+	tilesPerRow = (size + TILE - 1) / TILE;
+	tiles.assign((long)tilesPerRow * tilesPerRow, (double*)NULL);
+}
+
+double PairTable::get(int i, int j) const{
+	assert(i >= 0 && i < size && j >= 0 && j < size);
+	const double * tile = tiles[(long)(i / TILE) * tilesPerRow + j / TILE];
+	if(tile == NULL){
+		return unknown;
+	}
+	return tile[(i % TILE) * TILE + j % TILE];
+}
+
+double & PairTable::at(int i, int j){
+	assert(i >= 0 && i < size && j >= 0 && j < size);
+	double * & tile = tiles[(long)(i / TILE) * tilesPerRow + j / TILE];
+	if(tile == NULL){
+		tile = new double[TILE * TILE];
+		for(int k = 0; k < TILE * TILE; k++){
+			tile[k] = unknown;
+		}
+	}
+	return tile[(i % TILE) * TILE + j % TILE];
+}
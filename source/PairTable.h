@@ -0,0 +1,59 @@
+/*
+ * Copyright: Nicholas P Wiebe (2008-2009) and Irmtraud M Meyer (2008-2009)
+ * License: licensed under the GNU General Public License version 3 (GPLv3)
+ * PairTable.h
+ *
+ * Square table of doubles that only takes up space where it is written to. The table
+ * is divided into TILE x TILE tiles, which are allocated (and filled with the
+ * 'unknown' value) the first time one of their entries is written. Reading an entry
+ * of a tile that was never written gives 'unknown' without allocating anything, so
+ * creating a table is cheap however large it is, and its memory grows with the entries
+ * actually used (e.g. the band of column pairs at most maxSpan apart).
+ */
+
+#ifndef PAIRTABLE_H_
+#define PAIRTABLE_H_
+
+#include <vector>
+
+using namespace std;
+
+class PairTable {
+public:
+	PairTable();
+	PairTable(const PairTable & other);
+	PairTable & operator=(const PairTable & other);
+	virtual ~PairTable();
+
+	/**
+	 * makes the table size x size, with every entry equal to unknown; frees all tiles
+	 */
+	void reset(int size, double unknown);
+
+	/**
+	 * entry i,j (unknown if it was never written)
+	 */
+	double get(int i, int j) const;
+
+	/**
+	 * reference to entry i,j, for writing; allocates its tile if needed
+	 */
+	double & at(int i, int j);
+
+	static const int TILE = 64;
+
+private:
+	int size;
+	int tilesPerRow;
+	double unknown;
+
+	/**
+	 * tile (ti, tj) covers rows ti * TILE ... and columns tj * TILE ..., and is stored row by
+	 * row at tiles[ti * tilesPerRow + tj] (NULL until written)
+	 */
+	vector<double*> tiles;
+
+	void freeTiles();
+};
+
+#endif /* PAIRTABLE_H_ */
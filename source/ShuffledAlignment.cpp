@@ -11,6 +11,9 @@
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
+#include <cmath>
+#include <cctype>
+#include <map>
 #include "Utilities.h"
 
 //const string ShuffledAlignment::TEMP_FASTA_FILENAME = "temp.fasta";
@@ -19,7 +22,18 @@
 
 //const string ShuffledAlignment::RNAZ_SHUFFLER_LOC = "RNAz_perl/rnazRandomizeAln.pl";
 
+Shuffler ShuffledAlignment::shuffler = NATIVE_SHUFFLER;
+
 ShuffledAlignment::ShuffledAlignment(const Alignment & a){
+	unsigned int randomState = rand();
+	shuffleAll(a, randomState);
+}
+
+ShuffledAlignment::ShuffledAlignment(const Alignment & a, unsigned int * randomState){
+	shuffleAll(a, *randomState);
+}
+
+void ShuffledAlignment::shuffleAll(const Alignment & a, unsigned int & randomState){
 
 	alignmentName = a.alignmentName;//TODO: get rid of alignment name concept
 
@@ -39,86 +53,52 @@ ShuffledAlignment::ShuffledAlignment(const Alignment & a){
 		alignedStruct.push_back(-1);
 	}
 
-	//use RNAz to shuffle columns
-	shuffleRNAz();
-
-
-//
-//	vector<unsigned int> shuffleableColumns;
-//
-//	//copy struct, preserving only bps in 'th'
-//	//find columns that are not part of helix 'th':
-//	assert(a.alignmentLabels.size() == a.alignedStruct.size());
-//	for(unsigned int i = 0; i < a.alignedStruct.size(); i++){
-//		if(a.alignedStruct[i] != -1){
-//			alignedStruct.push_back(a.alignedStruct[i]);
-//		}
-//		else{
-//			alignedStruct.push_back(-1);
-//			shuffleableColumns.push_back(i);
-//		}
-//	}
-//
-//
-//	//cout << "number of unpaired columns\n";
-//	//cout << "The value of RAND_MAX is " <<  RAND_MAX << endl;
-//
-//	//shuffle list unpaired columns:
-//	for(unsigned int i = 0; i < shuffleableColumns.size(); i++){
-//		unsigned int random_column = rand();
-//
-//		random_column = i + random_column % (shuffleableColumns.size()-i);
-//
-//		//swap i with random_column
-//		int temp = shuffleableColumns[i];
-//		shuffleableColumns[i] = shuffleableColumns[random_column];
-//		shuffleableColumns[random_column] = temp;
-//	}
-//
-//	//reorder columns:
-//
-//
-//	int shuffleableColsIndex = 0;
-//	for(unsigned int i = 0; i < alignedStruct.size(); i++){
-//		if(alignedStruct[i] == -1){
-//			for(unsigned int j = 0; j < a.alignedSeqs.size(); j++){
-//				alignedSeqs[j]->at(i) = a.alignedSeqs[j]->at(shuffleableColumns[shuffleableColsIndex]);
-//			}
-//			shuffleableColsIndex++;
-//		}
-//	}
-//
-
-	//set seqs to reflect new shuffled alignment
-	vector<int>* temp;
-	vector<int>* temp2;
-	string * seq;
-
-	for (unsigned int i = 0; i < alignedSeqs.size(); i++){
-
-		temp = new vector<int>();
-		temp2 = new vector<int>();
-		seq = new string();
+	if(shuffler == RNAZ_SHUFFLER){
+		//use RNAz to shuffle columns
+		shuffleRNAz();
 
-		for (unsigned int j = 0; j < alignedSeqs[i]->length(); j++){
-			if (alignedSeqs[i]->at(j) != '-'){
-				temp->push_back(j);
-				*seq = *seq + alignedSeqs[i]->at(j);
-				temp2->push_back(temp->size() - 1);
+		//find where each column came from by its contents
+		map<string, int> columnIndex;
+		string column(alignedSeqs.size(), ' ');
+		for(unsigned int j = 0; j < a.alignedStruct.size(); j++){
+			for(unsigned int i = 0; i < a.alignedSeqs.size(); i++){
+				column[i] = (*a.alignedSeqs[i])[j];
 			}
-			else{
-				temp2->push_back(-1);
+			columnIndex[column] = j;
+		}
+		for(unsigned int j = 0; j < alignedStruct.size(); j++){
+			for(unsigned int i = 0; i < alignedSeqs.size(); i++){
+				column[i] = (*alignedSeqs[i])[j];
 			}
+			map<string, int>::iterator it = columnIndex.find(column);
+			if(it == columnIndex.end()){
+				sourceColumns.clear();
+				break;
+			}
+			sourceColumns.push_back(it->second);
 		}
-		seqs.push_back(seq);
-		seq2AlignmentMap.push_back(temp);
-		alignment2SeqMap.push_back(temp2);
+	}
+	else{
+		vector<int> columns;
+		for(unsigned int i = 0; i < alignedStruct.size(); i++){
+			columns.push_back(i);
+		}
+		sourceColumns = columns;
+		shuffleNative(columns, randomState);
+	}
 
+	//columns are copies of a's columns, and so are their patterns
+	if(sourceColumns.size() == alignedStruct.size() && a.columnPatterns.size() == a.alignedStruct.size()){
+		for(unsigned int j = 0; j < sourceColumns.size(); j++){
+			columnPatterns.push_back(a.columnPatterns[sourceColumns[j]]);
+		}
+		patternCount = a.patternCount;
+	}
+	else{
+		sourceColumns.clear();
 	}
 
-	fillSeqStructs();
-	labelHelices2();
-	initializeStatsMatrix();
+	initializeFromAlignedSeqs();
 
 }
 
@@ -248,7 +228,13 @@ ShuffledAlignment::ShuffledAlignment(const Alignment & a, int th, string treeFil
 		alignedSeqs.push_back(new string(tempAlignment[i]));
 	}
 
-	shuffleRNAz(shuffleableColumns);
+	if(shuffler == RNAZ_SHUFFLER){
+		shuffleRNAz(shuffleableColumns);
+	}
+	else{
+		unsigned int randomState = rand();
+		shuffleNative(shuffleableColumns, randomState);
+	}
 //
 //	//cout << "number of unpaired columns\n";
 //
@@ -289,36 +275,7 @@ ShuffledAlignment::ShuffledAlignment(const Alignment & a, int th, string treeFil
 //	}
 
 
-	//set seqs to reflect new shuffled alignment
-	vector<int>* temp;
-	vector<int>* temp2;
-	string * seq;
-
-	for (unsigned int i = 0; i < alignedSeqs.size(); i++){
-
-		temp = new vector<int>();
-		temp2 = new vector<int>();
-		seq = new string();
-
-		for (unsigned int j = 0; j < alignedSeqs[i]->length(); j++){
-			if (alignedSeqs[i]->at(j) != '-'){
-				temp->push_back(j);
-				*seq = *seq + alignedSeqs[i]->at(j);
-				temp2->push_back(temp->size() - 1);
-			}
-			else{
-				temp2->push_back(-1);
-			}
-		}
-		seqs.push_back(seq);
-		seq2AlignmentMap.push_back(temp);
-		alignment2SeqMap.push_back(temp2);
-
-	}
-
-	fillSeqStructs();
-	labelHelices2();
-	initializeStatsMatrix();
+	initializeFromAlignedSeqs();
 
 	//sanity check:
 	if(treeFile.compare("") != 0){
@@ -360,6 +317,112 @@ ShuffledAlignment::~ShuffledAlignment() {
 	clearAll();
 }
 
+void ShuffledAlignment::initializeFromAlignedSeqs(){
+	//set seqs to reflect new shuffled alignment
+	vector<int>* temp;
+	vector<int>* temp2;
+	string * seq;
+
+	for (unsigned int i = 0; i < alignedSeqs.size(); i++){
+
+		temp = new vector<int>();
+		temp2 = new vector<int>();
+		seq = new string();
+
+		for (unsigned int j = 0; j < alignedSeqs[i]->length(); j++){
+			if (alignedSeqs[i]->at(j) != '-'){
+				temp->push_back(j);
+				*seq += alignedSeqs[i]->at(j);
+				temp2->push_back(temp->size() - 1);
+			}
+			else{
+				temp2->push_back(-1);
+			}
+		}
+		seqs.push_back(seq);
+		seq2AlignmentMap.push_back(temp);
+		alignment2SeqMap.push_back(temp2);
+
+	}
+
+	fillSeqStructs();
+	labelHelices2();
+	initializeStatsMatrix();
+}
+
+void ShuffledAlignment::shuffleNative(const vector<int> & columns, unsigned int & randomState){
+
+	unsigned int seqCount = alignedSeqs.size();
+	double pairCount = seqCount * (seqCount - 1) / 2.0;
+
+	//bin columns by gap pattern + mean pairwise identity (rounded to 10%)
+	//map keeps the bins in a fixed order, so a given random state always
+	//produces the same shuffle
+	map<string, vector<int> > bins;
+	string key(seqCount + 1, ' ');
+	int counts[256];
+
+	for(unsigned int c = 0; c < columns.size(); c++){
+		memset(counts, 0, sizeof(counts));
+		for(unsigned int i = 0; i < seqCount; i++){
+			unsigned char base = alignedSeqs[i]->at(columns[c]);
+			key[i] = (base == '-') ? '-' : 'x';
+
+			//compare nucleotides by their mask, so that case (and T vs U) does not matter.
+			//Gaps count as 0, other symbols as themselves (in upper case)
+			int symbol = Utilities::nucleotideMask[base];
+			if(base == '-'){
+				symbol = 0;
+			}
+			else if(symbol == 0){
+				symbol = toupper(base);
+			}
+			counts[symbol]++;
+		}
+
+		//identical pairs in this column: sum over symbols of n choose 2
+		double matching = 0;
+		for(int i = 0; i < 256; i++){
+			matching += counts[i] * (counts[i] - 1) / 2.0;
+		}
+		double identity = (pairCount > 0) ? matching / pairCount : 1.0;
+		key[seqCount] = '0' + (int)floor(identity * 10 + 0.5);
+
+		bins[key].push_back(columns[c]);
+	}
+
+	//permute columns within each bin
+	vector<string> original(seqCount);
+	for(unsigned int i = 0; i < seqCount; i++){
+		original[i] = *alignedSeqs[i];
+	}
+	vector<int> originalSources(sourceColumns);
+
+	for(map<string, vector<int> >::iterator bin = bins.begin(); bin != bins.end(); bin++){
+		vector<int> & slots = bin->second;
+		vector<int> shuffled(slots);
+
+		for(unsigned int i = 0; i + 1 < shuffled.size(); i++){
+			unsigned int random_column = i + rand_r(&randomState) % (shuffled.size() - i);
+
+			//swap i with random_column
+			int temp = shuffled[i];
+			shuffled[i] = shuffled[random_column];
+			shuffled[random_column] = temp;
+		}
+
+		for(unsigned int k = 0; k < slots.size(); k++){
+			for(unsigned int i = 0; i < seqCount; i++){
+				(*alignedSeqs[i])[slots[k]] = original[i][shuffled[k]];
+			}
+			//keep track of where columns came from
+			if(!sourceColumns.empty()){
+				sourceColumns[slots[k]] = originalSources[shuffled[k]];
+			}
+		}
+	}
+}
+
 void ShuffledAlignment::shuffleRNAz(){
 
 	unsigned int original_length = alignedSeqs[0]->length();
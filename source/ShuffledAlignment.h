@@ -14,15 +14,23 @@
 
 using namespace std;
 
+enum Shuffler { NATIVE_SHUFFLER, RNAZ_SHUFFLER };
+
 class ShuffledAlignment: public Alignment {
 public:
 
 	/**
 	 * Creates a shuffled alignment from the given alignment a
 	 * Original structure is discarded. Shuffling is performed with
-	 * RNAz shuffling perl script.
+	 * the shuffler selected by ShuffledAlignment::shuffler.
 	 */
 	ShuffledAlignment(const Alignment & a);
+
+	/**
+	 * As above, but the native shuffler draws its random numbers from
+	 * randomState (see rand_r), so that samples can be reproduced.
+	 */
+	ShuffledAlignment(const Alignment & a, unsigned int * randomState);
 	/*
 	 * Create shuffled alignment from the given alignment a
 	 * Shuffle alignment, keeping only columns in true helix 'th' fixed
@@ -31,9 +39,35 @@ public:
 
 	virtual ~ShuffledAlignment();
 
+	/**
+	 * NATIVE_SHUFFLER (default) shuffles the in-memory alignment directly.
+	 * RNAZ_SHUFFLER runs rnazRandomizeAln.pl, and is kept for validation.
+	 */
+	static Shuffler shuffler;
+
 //static const string RNAZ_SHUFFLER_LOC;
 protected:
 
+	/**
+	 * copies names and sequences of a, and shuffles every column
+	 */
+	void shuffleAll(const Alignment & a, unsigned int & randomState);
+
+	/**
+	 * builds seqs, seq2AlignmentMap and alignment2SeqMap from alignedSeqs,
+	 * then the structure and stats tables
+	 */
+	void initializeFromAlignedSeqs();
+
+	/**
+	 * shuffles specified columns in memory, reproducing level 1 shuffling
+	 * of rnazRandomizeAln.pl: columns are binned by gap pattern and by mean
+	 * pairwise identity (rounded to the nearest 10%, ignoring case), and then permuted
+	 * within their bins.
+	 * If sourceColumns is set, it is permuted along with the columns.
+	 */
+	void shuffleNative(const vector<int> & columns, unsigned int & randomState);
+
 	/**
 	 * shuffles entire alignment using RNAz shuffler (rnazRandomizeAln.pl)
 	 * Uses level 1 shuffling (columns binned by mean pairwise identity,
@@ -0,0 +1,355 @@
+/*
+ * Copyright: Nicholas P Wiebe (2008-2009) and Irmtraud M Meyer (2008-2009)
+ * License: licensed under the GNU General Public License version 3 (GPLv3)
+ */
+
+#include "StemFinder.h"
+#include "Alignment.h"
+#include <algorithm>
+#include <cmath>
+
+int StemFinder::seededLength = 2000;
+
+//2-bit code of a base that is not A, C, G or U
+static const unsigned char NO_BASE = 4;
+
+//costs of the seeded search per window, per partner code looked up, and per seed hit,
+//in pairs tested by the exhaustive search (measured with bench/StemBench)
+static const double WINDOW_COST = 200;
+static const double LOOKUP_COST = 2;
+static const double HIT_COST = 35;
+
+//bit 0 of every nibble
+static const uint64_t NIBBLE_LOW = 0x1111111111111111ULL;
+
+static int baseNibble(char base){
+	switch(base){
+	case 'A':
+		return 1;
+	case 'U':
+		return 2;
+	case 'G':
+		return 4;
+	case 'C':
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+static unsigned char baseCode(char base){
+	switch(base){
+	case 'A':
+		return 0;
+	case 'C':
+		return 1;
+	case 'G':
+		return 2;
+	case 'U':
+		return 3;
+	default:
+		return NO_BASE;
+	}
+}
+
+//codes of the bases each code can pair with, ended by NO_BASE
+static const unsigned char codePartners[5][3] = {
+		{3, NO_BASE, NO_BASE}, //A: U
+		{2, NO_BASE, NO_BASE}, //C: G
+		{1, 3, NO_BASE}, //G: C, U
+		{0, 2, NO_BASE}, //U: A, G
+		{NO_BASE, NO_BASE, NO_BASE}
+};
+
+//codes that can pair, indexed [code][code]
+static const bool codesPair[5][5] = {
+		{false, false, false, true, false},
+		{false, false, true, false, false},
+		{false, true, false, true, false},
+		{true, false, true, false, false},
+		{false, false, false, false, false}
+};
+
+/**
+ * orders stems by anti-diagonal, then from the inside out
+ */
+static bool stemOrder(const Helix & a, const Helix & b){
+	int sa = a.pos5 + a.pos3;
+	int sb = b.pos5 + b.pos3;
+	if(sa != sb){
+		return sa < sb;
+	}
+	return a.pos5 > b.pos5;
+}
+
+static int partnerNibble(char base){
+	switch(base){
+	case 'A':
+		return 2; //U
+	case 'U':
+		return 1 | 4; //A, G
+	case 'G':
+		return 8 | 2; //C, U
+	case 'C':
+		return 4; //G
+	default:
+		return 0;
+	}
+}
+
+/**
+ * index of the lowest set bit of a non-zero word
+ */
+static inline int lowestBit(uint64_t word){
+	return __builtin_ctzll(word);
+}
+
+StemFinder::StemFinder(const string & seq) : seedLength(0), prefixShift(0) {
+	length = seq.length();
+	bases.assign(length / 16 + 2, 0);
+	partners.assign(length / 16 + 2, 0);
+	codes.resize(length);
+	for(int i = 0; i < length; i++){
+		codes[i] = baseCode(seq[i]);
+		bases[i / 16] |= (uint64_t)baseNibble(seq[i]) << (4 * (i % 16));
+		int k = length - 1 - i;
+		partners[k / 16] |= (uint64_t)partnerNibble(seq[i]) << (4 * (k % 16));
+	}
+}
+
+StemFinder::~StemFinder() {
+}
+
+bool StemFinder::canPair(char a, char b){
+	return (partnerNibble(a) & baseNibble(b)) != 0;
+}
+
+uint64_t StemFinder::nibbles(const vector<uint64_t> & words, int start){
+	int word = start / 16;
+	int shift = 4 * (start % 16);
+	uint64_t result = words[word] >> shift;
+	if(shift > 0){
+		result |= words[word + 1] << (64 - shift);
+	}
+	return result;
+}
+
+void StemFinder::findStems(int minStemLength, vector<Helix> & stems, int maxSpan){
+	if(length >= seededLength){
+		findStemsSeeded(minStemLength, stems, maxSpan);
+	}
+	else{
+		findStemsExhaustive(minStemLength, stems, maxSpan);
+	}
+}
+
+void StemFinder::findStemsExhaustive(int minStemLength, vector<Helix> & stems, int maxSpan) const{
+	for(int s = MIN_DIST; s <= 2 * length - 3; s++){
+		//innermost pair i0-j0 of the anti-diagonal, and the number of pairs on it
+		int i0 = (s - MIN_DIST) / 2;
+		int j0 = s - i0;
+		int steps = min(i0 + 1, length - j0);
+
+		//the span of step t is j0 - i0 + 2t
+		if(maxSpan < j0 - i0){
+			continue;
+		}
+		steps = min(steps, (maxSpan - (j0 - i0)) / 2 + 1);
+
+		//step t is the pair (i0 - t)-(j0 + t); base i0 - t is base k0 + t of the reversed sequence
+		int k0 = length - 1 - i0;
+		int run = 0;
+		for(int t = 0; t < steps; t += 16){
+			uint64_t x = nibbles(partners, k0 + t) & nibbles(bases, j0 + t);
+			uint64_t paired = (x | (x >> 1) | (x >> 2) | (x >> 3)) & NIBBLE_LOW;
+			int valid = min(16, steps - t);
+
+			int m = 0;
+			while(m < valid){
+				uint64_t rest = paired >> (4 * m);
+				if(rest & 1){
+					//extend the run over the following pairs
+					uint64_t unpaired = ~rest & NIBBLE_LOW;
+					int ones = (unpaired == 0) ? 16 - m : lowestBit(unpaired) / 4;
+					ones = min(ones, valid - m);
+					run += ones;
+					m += ones;
+				}
+				else{
+					//run ends before step t + m: its outer pair is the one at the previous step
+					if(run > minStemLength){
+						int outer = t + m - 1;
+						stems.push_back(Helix(i0 - outer, j0 + outer, run));
+					}
+					run = 0;
+					int zeros = (rest == 0) ? 16 - m : lowestBit(rest) / 4;
+					m += min(zeros, valid - m);
+				}
+			}
+		}
+
+		//stem on the edge of the sequence (outer pair includes its first or last base)
+		if(run > minStemLength){
+			int outer = steps - 1;
+			stems.push_back(Helix(i0 - outer, j0 + outer, run));
+		}
+	}
+}
+
+void StemFinder::findStemsSeeded(int minStemLength, vector<Helix> & stems, int maxSpan){
+	//every stem contains k stacked pairs; longer stems are found from their innermost k pairs
+	int k = max(1, min(minStemLength + 1, MAX_SEED));
+	if(length < k){
+		return;
+	}
+	if(!seedsPayOff(k, maxSpan)){
+		findStemsExhaustive(minStemLength, stems, maxSpan);
+		return;
+	}
+	buildSeedIndex(k);
+
+	vector<Helix> found;
+	vector<unsigned int> partnerCodes;
+	vector<unsigned int> expanded;
+	for(int p = 0; p + k <= length; p++){
+		if(windowCode[p] < 0){
+			continue;
+		}
+
+		//codes of the 3' windows that pair with window p: base r of such a window pairs with
+		//base p + k - 1 - r, and G and U have two partners each
+		partnerCodes.assign(1, 0);
+		for(int r = 0; r < k; r++){
+			const unsigned char * partner = codePartners[codes[p + k - 1 - r]];
+			expanded.clear();
+			for(unsigned int c = 0; c < partnerCodes.size(); c++){
+				for(int m = 0; partner[m] != NO_BASE; m++){
+					expanded.push_back((partnerCodes[c] << 2) | partner[m]);
+				}
+			}
+			partnerCodes.swap(expanded);
+		}
+
+		//seed pairs p-(q+k-1) ... (p+k-1)-q: its innermost pair must be MIN_DIST apart,
+		//and its outer pair at most maxSpan apart
+		int lowest = p + k - 1 + MIN_DIST;
+		int highest = (maxSpan >= length) ? length - k : p + maxSpan - k + 1;
+
+		for(unsigned int c = 0; c < partnerCodes.size(); c++){
+			uint64_t partnerCode = (uint64_t)partnerCodes[c] << 32;
+			unsigned int prefix = partnerCodes[c] >> prefixShift;
+			const uint64_t * bucket = &seedIndex[0] + prefixStart[prefix];
+			const uint64_t * bucketEnd = &seedIndex[0] + prefixStart[prefix + 1];
+			const uint64_t * w = lower_bound(bucket, bucketEnd, partnerCode | lowest);
+			for(; w != bucketEnd && *w <= (partnerCode | highest); w++){
+				int q = *w & 0xffffffff;
+
+				//only the innermost seed of a stem is extended
+				int in5 = p + k;
+				int in3 = q - 1;
+				if(in3 - in5 >= MIN_DIST && codesPair[codes[in5]][codes[in3]]){
+					continue;
+				}
+
+				int out5 = p;
+				int out3 = q + k - 1;
+				while(out5 > 0 && out3 < length - 1 && out3 - out5 <= maxSpan - 2
+						&& codesPair[codes[out5 - 1]][codes[out3 + 1]]){
+					out5--;
+					out3++;
+				}
+
+				int run = out3 - q + 1;
+				if(run > minStemLength){
+					found.push_back(Helix(out5, out3, run));
+				}
+			}
+		}
+	}
+
+	sort(found.begin(), found.end(), stemOrder);
+	stems.insert(stems.end(), found.begin(), found.end());
+}
+
+bool StemFinder::seedsPayOff(int k, int maxSpan) const{
+	//a window with g G's and U's looks up 2^g partner codes
+	double lookups = 0;
+	int valid = 0; //number of A, C, G, U bases ending at position i
+	int wobble = 0; //number of G, U among the last min(valid, k) of them
+	double baseCount[NO_BASE + 1] = {0, 0, 0, 0, 0};
+	for(int i = 0; i < length; i++){
+		baseCount[codes[i]]++;
+		if(codes[i] == NO_BASE){
+			valid = 0;
+			wobble = 0;
+			continue;
+		}
+		valid++;
+		wobble += (codes[i] >= 2);
+		if(valid > k){
+			wobble -= (codes[i - k] >= 2);
+		}
+		if(valid >= k){
+			lookups += 1 << wobble;
+		}
+	}
+
+	//a seed of k pairs is expected to hit pairChance^k of the windows in reach, where
+	//pairChance is the chance that two bases drawn from the sequence pair
+	double pairChance = 0;
+	for(int a = 0; a < NO_BASE; a++){
+		for(int b = 0; b < NO_BASE; b++){
+			if(codesPair[a][b]){
+				pairChance += baseCount[a] * baseCount[b] / ((double)length * length);
+			}
+		}
+	}
+	double span = min(length, maxSpan);
+	double pairs = span * (length - span / 2);
+	double hits = pairs * pow(pairChance, k);
+
+	return length * WINDOW_COST + lookups * LOOKUP_COST + hits * HIT_COST < pairs;
+}
+
+void StemFinder::buildSeedIndex(int k){
+	if(seedLength == k){
+		return;
+	}
+	seedLength = k;
+	unsigned int mask = (1u << (2 * k)) - 1;
+
+	//window starting at position b -> 2-bit code of its k bases (5' base most significant).
+	//Windows containing other bases are left out
+	windowCode.assign(length - k + 1, -1);
+	seedIndex.clear();
+	unsigned int code = 0;
+	int valid = 0; //number of A, C, G, U bases ending at position i
+	for(int i = 0; i < length; i++){
+		if(codes[i] == NO_BASE){
+			valid = 0;
+			code = 0;
+			continue;
+		}
+		code = ((code << 2) | codes[i]) & mask;
+		valid++;
+		if(valid >= k){
+			windowCode[i - k + 1] = code;
+			seedIndex.push_back(((uint64_t)code << 32) | (i - k + 1));
+		}
+	}
+	sort(seedIndex.begin(), seedIndex.end());
+
+	//about one window per prefix
+	int prefixBits = 0;
+	while(prefixBits < 2 * k && ((size_t)1 << prefixBits) < seedIndex.size()){
+		prefixBits++;
+	}
+	prefixShift = 2 * k - prefixBits;
+	prefixStart.assign(((size_t)1 << prefixBits) + 1, 0);
+	for(unsigned int w = 0; w < seedIndex.size(); w++){
+		prefixStart[(seedIndex[w] >> 32 >> prefixShift) + 1]++;
+	}
+	for(unsigned int c = 1; c < prefixStart.size(); c++){
+		prefixStart[c] += prefixStart[c - 1];
+	}
+}
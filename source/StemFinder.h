@@ -0,0 +1,121 @@
+/*
+ * Copyright: Nicholas P Wiebe (2008-2009) and Irmtraud M Meyer (2008-2009)
+ * License: licensed under the GNU General Public License version 3 (GPLv3)
+ * StemFinder.h
+ *
+ * Finds all maximal stems (runs of stacked canonical base pairs) of a sequence.
+ * Stacked pairs i-j, (i-1)-(j+1), ... lie on the anti-diagonal i + j = s, and are
+ * compared 16 at a time: the sequence is packed one-hot, 4 bits per base, and the
+ * reversed sequence is packed as the set of bases each base can pair with. Along an
+ * anti-diagonal both advance together, so one AND of two 64-bit words tests 16 pairs,
+ * and run lengths come from counting trailing bits.
+ *
+ * Long sequences are searched from k-mer seeds instead: every window of the sequence is
+ * indexed, each window looks up the windows that can pair with it (including GU pairs),
+ * and each hit that is the innermost part of a stem is extended outwards. This only
+ * visits the stems actually present, rather than all L^2/2 pairs. Sequences where
+ * the seeds would cost more than that (because they are short, or rich in G and U, which
+ * have two partners each) are searched exhaustively.
+ */
+
+#ifndef STEMFINDER_H_
+#define STEMFINDER_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <climits>
+#include "Helix.h"
+
+using namespace std;
+
+class StemFinder {
+public:
+	StemFinder(const string & seq);
+	virtual ~StemFinder();
+
+	/**
+	 * appends every maximal stem longer than minStemLength to stems. The innermost pair of
+	 * a stem is at least MIN_DIST apart, and pairs more than maxSpan apart count as
+	 * unpaired. Stems are ordered by anti-diagonal, then from the inside out.
+	 * Not const: it may build the seed index (see findStemsSeeded)
+	 */
+	void findStems(int minStemLength, vector<Helix> & stems, int maxSpan = INT_MAX);
+
+	/**
+	 * findStems, by testing every pair of the sequence
+	 */
+	void findStemsExhaustive(int minStemLength, vector<Helix> & stems, int maxSpan = INT_MAX) const;
+
+	/**
+	 * findStems, by extending k-mer seeds. Gives the same stems, in the same order, as
+	 * findStemsExhaustive, which it calls instead if the seeds do not pay off (see seedsPayOff).
+	 * Builds the seed index the first time (and whenever the seed length changes), so one
+	 * StemFinder must not be searched from several threads at once.
+	 */
+	void findStemsSeeded(int minStemLength, vector<Helix> & stems, int maxSpan = INT_MAX);
+
+	/**
+	 * true if a and b form a canonical (Watson-Crick or GU) base pair
+	 */
+	static bool canPair(char a, char b);
+
+	/**
+	 * findStems uses findStemsSeeded for sequences at least this long (default = 2000)
+	 */
+	static int seededLength;
+
+	/**
+	 * maximum length of the seeds (a window with k G's and U's looks up 2^k partner codes)
+	 */
+	static const int MAX_SEED = 10;
+
+private:
+	int length;
+
+	/**
+	 * the sequence as 2-bit codes (A = 0, C = 1, G = 2, U = 3), anything else = NO_BASE
+	 */
+	vector<unsigned char> codes;
+
+	/**
+	 * one-hot nibbles of the sequence (A = 1, U = 2, G = 4, C = 8, anything else = 0),
+	 * 16 per word, followed by a zero word
+	 */
+	vector<uint64_t> bases;
+
+	/**
+	 * nibbles of the reversed sequence: the bases that can pair with each base
+	 */
+	vector<uint64_t> partners;
+
+	/**
+	 * the 16 nibbles starting at nibble index start
+	 */
+	static uint64_t nibbles(const vector<uint64_t> & words, int start);
+
+	/**
+	 * index of the windows of seedLength bases, built by findStemsSeeded and kept for further
+	 * searches with the same seed length (0 if not built): the code of each window (-1 if it
+	 * holds anything but A, C, G, U), the windows as (code << 32 | start) in ascending order,
+	 * and where the windows whose code starts with each prefix (code >> prefixShift) begin.
+	 * There are about as many prefixes as windows, so the index takes O(length) space however
+	 * long the seeds are
+	 */
+	int seedLength;
+	vector<int> windowCode;
+	vector<uint64_t> seedIndex;
+	int prefixShift;
+	vector<int> prefixStart;
+
+	void buildSeedIndex(int k);
+
+	/**
+	 * true if searching from seeds of k pairs is expected to be faster than testing every
+	 * pair: the seeds cost more when they are short, when the sequence is rich in G and U
+	 * (which have two partners each), or when maxSpan leaves few pairs to test
+	 */
+	bool seedsPayOff(int k, int maxSpan) const;
+};
+
+#endif /* STEMFINDER_H_ */
@@ -5,63 +5,90 @@
 # Add inputs and outputs from these tool invocations to the build variables 
 CPP_SRCS += \
 ../AlignedHelix.cpp \
+../AlignedHelixSet.cpp \
 ../Alignment.cpp \
 ../AlignmentGenerator.cpp \
 ../BasePair.cpp \
+../ColumnLikelihoodCache.cpp \
+../ColumnProfiles.cpp \
 ../CompetingHelix.cpp \
+../CompiledTree.cpp \
 ../EvolModel.cpp \
+../FelsWorkspace.cpp \
 ../Helix.cpp \
 ../HelixCore.cpp \
 ../HelixFinder.cpp \
 ../HelixGroup.cpp \
 ../InterestingRegion.cpp \
+../MafReader.cpp \
+../PairTable.cpp \
 ../SeqHelix.cpp \
 ../ShuffledAlignment.cpp \
 ../StatsWrapper.cpp \
+../StemFinder.cpp \
 ../TransatMain.cpp \
 ../Tree.cpp \
 ../UTMatrix.cpp \
-../Utilities.cpp 
+../Utilities.cpp \
+../WindowScanner.cpp 
 
 OBJS += \
 ./AlignedHelix.o \
+./AlignedHelixSet.o \
 ./Alignment.o \
 ./AlignmentGenerator.o \
 ./BasePair.o \
+./ColumnLikelihoodCache.o \
+./ColumnProfiles.o \
 ./CompetingHelix.o \
+./CompiledTree.o \
 ./EvolModel.o \
+./FelsWorkspace.o \
 ./Helix.o \
 ./HelixCore.o \
 ./HelixFinder.o \
 ./HelixGroup.o \
 ./InterestingRegion.o \
+./MafReader.o \
+./PairTable.o \
 ./SeqHelix.o \
 ./ShuffledAlignment.o \
 ./StatsWrapper.o \
+./StemFinder.o \
 ./TransatMain.o \
 ./Tree.o \
 ./UTMatrix.o \
-./Utilities.o 
+./Utilities.o \
+./WindowScanner.o 
 
 CPP_DEPS += \
 ./AlignedHelix.d \
+./AlignedHelixSet.d \
 ./Alignment.d \
 ./AlignmentGenerator.d \
 ./BasePair.d \
+./ColumnLikelihoodCache.d \
+./ColumnProfiles.d \
 ./CompetingHelix.d \
+./CompiledTree.d \
 ./EvolModel.d \
+./FelsWorkspace.d \
 ./Helix.d \
 ./HelixCore.d \
 ./HelixFinder.d \
 ./HelixGroup.d \
 ./InterestingRegion.d \
+./MafReader.d \
+./PairTable.d \
 ./SeqHelix.d \
 ./ShuffledAlignment.d \
 ./StatsWrapper.d \
+./StemFinder.d \
 ./TransatMain.d \
 ./Tree.d \
 ./UTMatrix.d \
-./Utilities.d 
+./Utilities.d \
+./WindowScanner.d 
 
 
 # Each subdirectory must supply rules for building sources it contributes
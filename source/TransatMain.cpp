@@ -16,7 +16,14 @@
 #include "HelixFinder.h"
 #include "AlignedHelix.h"
 #include "ShuffledAlignment.h"
+#include "CompiledTree.h"
+#include "StemFinder.h"
+#include "MafReader.h"
+#include "WindowScanner.h"
 #include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <climits>
 
 using namespace std;
 
@@ -33,7 +40,11 @@ int main(int argc, char** argv) {
 	bool growHelices = false;
 	string filename = "";
 	string structFilename = "";
+	string mafFilename = "";
+	int window = 2000;
+	int step = 0;
 	bool noStruct = false;
+	unsigned int seed = (unsigned)time(0);
 
 	for(int i = 1; i < argc; i++){
 		string temp = argv[i];
@@ -48,6 +59,36 @@ int main(int argc, char** argv) {
 				exit(-1);
 			}
 		}
+		else if(temp.compare("-maf") == 0){
+			i++;
+			if(i < argc){
+				mafFilename = argv[i];
+			}
+			else{
+				cerr << "Error: expecting filename following \"-maf\" argument\n";
+				exit(-1);
+			}
+		}
+		else if (temp.compare("-window") == 0){
+			i++;
+			if(i < argc && atoi(argv[i]) > 0){
+				window = atoi(argv[i]);
+			}
+			else{
+				cerr << "Error: expecting positive integer following \"-window\" argument\n";
+				exit(-1);
+			}
+		}
+		else if (temp.compare("-step") == 0){
+			i++;
+			if(i < argc && atoi(argv[i]) > 0){
+				step = atoi(argv[i]);
+			}
+			else{
+				cerr << "Error: expecting positive integer following \"-step\" argument\n";
+				exit(-1);
+			}
+		}
 		else if (temp.compare("-ct") == 0){
 			i++;
 			if(i < argc){
@@ -61,10 +102,25 @@ int main(int argc, char** argv) {
 		else if (temp.compare("-minSL") == 0){
 			i++;
 			if(i < argc){
-				Alignment::minStemLength = atoi(argv[i]);
+				//a comma-separated list of lengths is swept in one run
+				string lengths = argv[i];
+				HelixFinder::minStemLengths.clear();
+				size_t start = 0;
+				while(true){
+					HelixFinder::minStemLengths.push_back(atoi(lengths.c_str() + start));
+					start = lengths.find(',', start);
+					if(start == string::npos){
+						break;
+					}
+					start++;
+				}
+				Alignment::minStemLength = *min_element(HelixFinder::minStemLengths.begin(), HelixFinder::minStemLengths.end());
+				if(HelixFinder::minStemLengths.size() == 1){
+					HelixFinder::minStemLengths.clear();
+				}
 			}
 			else{
-				cerr << "Error: expecting integer following \"-minSL\" argument\n";
+				cerr << "Error: expecting integer (or comma-separated integers) following \"-minSL\" argument\n";
 				exit(-1);
 			}
 		}
@@ -89,6 +145,100 @@ int main(int argc, char** argv) {
 				exit(-1);
 			}
 		}
+		else if (temp.compare("-seed") == 0){
+			i++;
+			if(i < argc){
+				seed = strtoul(argv[i], NULL, 10);
+			}
+			else{
+				cerr << "Error: expecting integer following \"-seed\" argument\n";
+				exit(-1);
+			}
+		}
+		else if (temp.compare("-shuffler") == 0){
+			i++;
+			string shuffler = (i < argc) ? argv[i] : "";
+			if(shuffler.compare("native") == 0){
+				ShuffledAlignment::shuffler = NATIVE_SHUFFLER;
+			}
+			else if(shuffler.compare("rnaz") == 0){
+				ShuffledAlignment::shuffler = RNAZ_SHUFFLER;
+			}
+			else{
+				cerr << "Error: expecting \"native\" or \"rnaz\" following \"-shuffler\" argument\n";
+				exit(-1);
+			}
+		}
+		else if (temp.compare("-threads") == 0){
+			i++;
+			if(i < argc && atoi(argv[i]) > 0){
+				HelixFinder::threads = atoi(argv[i]);
+			}
+			else{
+				cerr << "Error: expecting positive integer following \"-threads\" argument\n";
+				exit(-1);
+			}
+		}
+		else if (temp.compare("-maxSpan") == 0){
+			i++;
+			if(i < argc && atoi(argv[i]) >= MIN_DIST){
+				Alignment::maxSpan = atoi(argv[i]);
+			}
+			else{
+				cerr << "Error: expecting integer of at least " << MIN_DIST << " following \"-maxSpan\" argument\n";
+				exit(-1);
+			}
+		}
+		else if (temp.compare("-minLogLikeRatio") == 0){
+			i++;
+			if(i < argc){
+				HelixFinder::minLogLikeRatio = atof(argv[i]);
+			}
+			else{
+				cerr << "Error: expecting number following \"-minLogLikeRatio\" argument\n";
+				exit(-1);
+			}
+		}
+		else if (temp.compare("-maxPvalue") == 0){
+			i++;
+			if(i < argc){
+				HelixFinder::maxPvalue = atof(argv[i]);
+			}
+			else{
+				cerr << "Error: expecting number following \"-maxPvalue\" argument\n";
+				exit(-1);
+			}
+		}
+		else if (temp.compare("-seededLength") == 0){
+			i++;
+			if(i < argc && atoi(argv[i]) > 0){
+				StemFinder::seededLength = atoi(argv[i]);
+			}
+			else{
+				cerr << "Error: expecting positive integer following \"-seededLength\" argument\n";
+				exit(-1);
+			}
+		}
+		else if (temp.compare("-kernel") == 0){
+			i++;
+			string kernel = (i < argc) ? argv[i] : "";
+			if(kernel.compare("auto") == 0){
+				CompiledTree::kernel = AUTO_KERNEL;
+			}
+			else if(kernel.compare("scalar") == 0){
+				CompiledTree::kernel = SCALAR_KERNEL;
+			}
+			else if(kernel.compare("sse2") == 0){
+				CompiledTree::kernel = SSE2_KERNEL;
+			}
+			else if(kernel.compare("avx2") == 0){
+				CompiledTree::kernel = AVX2_KERNEL;
+			}
+			else{
+				cerr << "Error: expecting \"auto\", \"scalar\", \"sse2\" or \"avx2\" following \"-kernel\" argument\n";
+				exit(-1);
+			}
+		}
 		else if(temp.compare("-noPvalues") == 0){
 			//if this argument is given, no null distributions will be generated, and so no
 			//pvalues will be calculated. The Pvalue column in the output will be filled with zeros
@@ -125,8 +275,8 @@ int main(int argc, char** argv) {
 
 	//check for missing args
 	bool missingArgs = false;
-	if(filename.compare("") == 0){
-		cerr << "Error: must supply an alignment file (use '-fasta <filename>')\n.";
+	if(filename.compare("") == 0 && mafFilename.compare("") == 0){
+		cerr << "Error: must supply an alignment file (use '-fasta <filename>' or '-maf <filename>')\n.";
 		missingArgs = true;
 	}
 	if(treeFile.compare("") == 0){
@@ -135,10 +285,60 @@ int main(int argc, char** argv) {
 	}
 
 
+	if(!pVals && HelixFinder::maxPvalue < 1){
+		cerr << "Error: \"-maxPvalue\" needs pvalues, and cannot be combined with \"-noPvalues\"\n";
+		missingArgs = true;
+	}
+	if(!HelixFinder::minStemLengths.empty() && (growHelices || coverageInfo)){
+		cerr << "Error: a \"-minSL\" sweep cannot be combined with \"-grow\" or \"-coverage\"\n";
+		missingArgs = true;
+	}
+	if(mafFilename.compare("") != 0 && (bpTable || growHelices || coverageInfo || structFilename.compare("") != 0
+			|| HelixFinder::realign != NO_REALIGN)){
+		cerr << "Error: \"-maf\" cannot be combined with \"-bpTable\", \"-grow\", \"-coverage\", \"-ct\" or \"-realign\"\n";
+		missingArgs = true;
+	}
+
+
 	if(missingArgs){
 		exit(-1);
 	}
 
+	srand(seed);
+
+	if(mafFilename.compare("") != 0){
+		//scan a long alignment in overlapping windows
+		if(step == 0){
+			step = max(1, window / 2);
+		}
+		if(step > window - MIN_DIST){
+			cerr << "Error: \"-step\" must be at most \"-window\" minus " << MIN_DIST
+					<< ", as only helices spanning at most window - step columns are reported\n";
+			exit(-1);
+		}
+		//helices up to this span always lie in the window that reports them (see WindowScanner)
+		if(Alignment::maxSpan == INT_MAX){
+			Alignment::maxSpan = window - step;
+		}
+		else if(Alignment::maxSpan > window - step){
+			cerr << "Warning: only helices spanning at most window - step = " << window - step
+					<< " columns are reported; lowering \"-maxSpan\" to " << window - step << "\n";
+			Alignment::maxSpan = window - step;
+		}
+
+		Tree root(treeFile);
+		WindowScanner scanner(root, window, step);
+		MafReader reader(mafFilename, scanner.names);
+		scanner.scan(reader, randomTrials, pVals);
+		reader.checkSpecies();
+
+		HelixFinder::printNullStats();
+		HelixFinder::printRescaled();
+		cerr << "windows scanned: " << scanner.windowCount << " (" << reader.blockCount << " alignment blocks)\n";
+		cerr << "done!\n";
+		return 0;
+	}
+
 
 	Alignment * a;
 	if (!noStruct && structFilename.compare("") == 0){
@@ -160,7 +360,7 @@ int main(int argc, char** argv) {
 	}
 	else if(coverageInfo){
 		HelixFinder hf(a);
-		hf.findAllHelices();
+		hf.findAllHelices(HelixFinder::threads);
 
 		double coverage;
 		double exactCoverage;
@@ -174,11 +374,15 @@ int main(int argc, char** argv) {
 			hf.findAllHelicesGrow(root, 0, -5);
 		}
 		else{
-			hf.findAllHelices();
+			hf.findAllHelices(HelixFinder::threads);
 		}
 		hf.allHelicesPvalueTable(randomTrials, root, pVals);
 	}
 
+	HelixFinder::addRescaled(a->felsWorkspace);
+	HelixFinder::printNullStats();
+	HelixFinder::printRescaled();
+
 	cerr << "done!\n";
 	delete a;
 	return 0;
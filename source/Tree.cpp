@@ -13,17 +13,13 @@
 #include "Alignment.h"
 #include <cstdlib>
 #include "Utilities.h"
-#include <limits>
+#include "CompiledTree.h"
 
 int Tree::leafCount = 1;
 bool Tree::nonGapPair = true;
-//bool Tree::felsDoubleUnderflow = false;
-//bool Tree::felsSingleUnderflow = false;
 
-//setting this variables to true suppresses the underflow warning...
-//for distribution, set to true, because it's a confusing error.
-bool Tree::felsDoubleUnderflow = true;
-bool Tree::felsSingleUnderflow = true;
+//for distribution, set to false, because it's a confusing error.
+bool Tree::underflowWarnings = false;
 
 Tree::Tree(string filename)
 {
@@ -120,6 +116,7 @@ Tree::Tree(int leaves, double length){
 		rightChild->setUpMatrices();
 
 		seqName = "";
+		nodeCount = 1 + leftChild->nodeCount + rightChild->nodeCount;
 	}
 	else{
 		assert(length == 0);
@@ -129,146 +126,26 @@ Tree::Tree(int leaves, double length){
 		leftChild = NULL;
 		rightChild = NULL;
 		seqName = ss.str();
+		nodeCount = 1;
 	}
 
 }
 
 
-double Tree::calcFelsDouble(Alignment & a, int pos5, int pos3){
-	double likelihood = 0.0;
-
-	//leaf:
-	if(leftChild == NULL && rightChild == NULL){
-		map<Tree*,unsigned int> leaf2SeqMap = getLeaf2SeqMap(a.seqNames);
-		unsigned int seqIndex = leaf2SeqMap.find(this)->second;
-
-		char base5,base3;
-		base5 = a.alignedSeqs[seqIndex]->at(pos5);
-		base3 = a.alignedSeqs[seqIndex]->at(pos3);
-
-
-		//convert Ns to gaps:
-		if (base5 == 'N' || base5 == 'n'){
-			base5 = '-';
-		}
-		if (base3 == 'N' || base3 == 'n'){
-			base3 = '-';
-		}
-
-		vector<int> leftInterpreted, rightInterpreted;
-
-		if(nonGapPair && base5 == '-' && base3 != '-'){
-			//case: 5' base is a gap, and the other is not
-			rightInterpreted =Utilities::interpret(base3);
-			leftInterpreted = interpretNonPairingGap(rightInterpreted);
-		}
-		else if(nonGapPair && base3 == '-' && base5 != '-'){
-			//case 3' base is a gap, and the other is not
-			leftInterpreted = Utilities::interpret(base5);
-			rightInterpreted = interpretNonPairingGap(leftInterpreted);
-		}
-		else{
-			//interpret chars
-			leftInterpreted = Utilities::interpret(base5);
-			rightInterpreted =Utilities::interpret(base3);
-
-		}
-
-		for(int i = 0; i < 4; i++){
-			for(int j = 0; j < 4; j++){
-				fels[4 * i + j] = leftInterpreted[i] * rightInterpreted[j];
-			}
-		}
-
-	}
-	//inner node
-	else{
-		//set fels array for children
-		leftChild->calcFelsDouble(a, pos5, pos3);
-		rightChild->calcFelsDouble(a, pos5, pos3);
-
-		// then calculate the likelihood based on the likelihood of the two child nodes
-		for(int i = 0; i < 16; i++){
-			double temp1 = 0.0;
-			double temp2 = 0.0;
-			for(int j = 0; j < 16; j++){
-				temp1 += leftChild->matrix16[i][j] * leftChild->fels[j];
-				temp2 += rightChild->matrix16[i][j] * rightChild->fels[j];
-			}
-			fels[i] = temp1 * temp2;
-			if(fels[i] <= 0.0){
-				if(!felsDoubleUnderflow){
-					cerr << "Warning: calcFelsDouble: underflow problem...\n";
-					felsDoubleUnderflow = true;
-				}
-				fels[i] = numeric_limits<double>::min();
-			}
-		}
-	}
-	//root
-	if(parent == NULL){
-		for(int i = 0; i < 16; i++){
-			likelihood += EvolModel::ePiDouble[i] * fels[i];
-
-		}
-//assert(likelihood > 0);
-	}
-
-	return likelihood;
+double Tree::calcFelsDouble(Alignment & a, int pos5, int pos3, FelsWorkspace & ws) const{
+	return a.compiledTree(*this).calcFelsDouble(a, pos5, pos3, ws);
 }
 
-double Tree::calcFelsSingle(Alignment & a, int pos){
-	double likelihood = 0.0;
-
-	//leaf
-	if(leftChild == NULL && rightChild == NULL){
-		map<Tree*,unsigned int> leaf2SeqMap = getLeaf2SeqMap(a.seqNames);
-		unsigned int seqIndex = leaf2SeqMap.find(this)->second;
-
-		//interpret char
-		vector<int> interpreted = Utilities::interpret(a.alignedSeqs[seqIndex]->at(pos));
-
-		for(int i = 0; i < 4; i++){
-			fels[i] = interpreted[i];
-			//note: should fels be averaged, so that it sums to 1? will have to think about this...
-			//answer = no. See Felsenstein 1981, Extensions section
-		}
-
-	}
-	//inner node
-	else{
-		//set fels array for children
-		leftChild->calcFelsSingle(a, pos);
-		rightChild->calcFelsSingle(a, pos);
-
-		// then calculate the likelihood here
-		for(int i = 0; i < 4; i++){
-			double temp1 = 0.0;
-			double temp2 = 0.0;
-			for(int j = 0; j < 4; j++){
-				temp1 += leftChild->matrix4[i][j] * leftChild->fels[j];
-				temp2 += rightChild->matrix4[i][j] * rightChild->fels[j];
-			}
-			fels[i] = temp1 * temp2;
-			if(fels[i] <= 0.0){
-				if(!felsSingleUnderflow){
-					cerr << "Warning: calcFelsSingle: underflow problem...\n";
-					felsSingleUnderflow = true;
-				}
-				fels[i] = numeric_limits<double>::min();
-			}
-		}
-	}
-	//root
-	if(parent == NULL){
-		for(int i = 0; i < 4; i++){
-			likelihood += EvolModel::ePiSingle[i] * fels[i];
-		}
+double Tree::calcFelsSingle(Alignment & a, int pos, FelsWorkspace & ws) const{
+	return a.compiledTree(*this).calcFelsSingle(a, pos, ws);
+}
 
-//		assert(likelihood > 0);
-	}
+double Tree::logFelsDouble(Alignment & a, int pos5, int pos3, FelsWorkspace & ws) const{
+	return a.compiledTree(*this).logFelsDouble(a, pos5, pos3, ws);
+}
 
-	return likelihood;
+double Tree::logFelsSingle(Alignment & a, int pos, FelsWorkspace & ws) const{
+	return a.compiledTree(*this).logFelsSingle(a, pos, ws);
 }
 
 map<Tree*, unsigned int> Tree::getLeaf2SeqMap(vector<string> & SeqNames){
@@ -431,6 +308,7 @@ void Tree::createChildren(list<string*> & tokens)
 		rightChild = new Tree(rightTokens);
 		rightChild->parent = this;
 
+		nodeCount = 1 + leftChild->nodeCount + rightChild->nodeCount;
 	}
 	//case: leaf
 	else{
@@ -438,6 +316,7 @@ void Tree::createChildren(list<string*> & tokens)
 		rightChild = NULL;
 		seqName = **tokens.begin();
 		branchLength = atof((*--tokens.end())->c_str());
+		nodeCount = 1;
 	}
 	setUpMatrices();
 
@@ -505,38 +384,6 @@ string Tree::newickString(){
 	return ss.str();
 }
 
-vector<int> Tree::interpretNonPairingGap(vector<int> & nongap){
-	vector<int> iTable;
-	assert(nongap.size() == 4);
-
-	for(int i = 0; i < 4; i++){
-		iTable.push_back(1);
-	}
-
-	if(nongap[0] == 1){
-		//A
-		iTable[1] = 0;
-	}
-	if(nongap[1] == 1){
-		//U
-		iTable[0] = 0;
-		iTable[2] = 0;
-	}
-	if(nongap[2] == 1){
-		//G
-		iTable[1] = 0;
-		iTable[3] = 0;
-	}
-	if(nongap[3] == 1){
-		//C
-		iTable[2] = 0;
-	}
-
-	//note: special chars 'b', 'd' and 'k' produce an all-zero iTable... So watch out!
-	return iTable;
-}
-
-
 double Tree::totalLength(){
 	double length = branchLength;
 
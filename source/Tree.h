@@ -13,6 +13,7 @@
 #include <list>
 #include <map>
 #include <vector>
+#include "FelsWorkspace.h"
 
 using namespace std;
 
@@ -33,8 +34,21 @@ public:
 
 	string seqName; //for leaves only - otherwise = "";
 
-	double calcFelsDouble(Alignment & a, int pos5, int pos3);
-	double calcFelsSingle(Alignment & a, int pos);
+	/**
+	 * likelihood of alignment columns pos5 and pos3 under the paired (resp. single) model.
+	 * Partial likelihoods are stored in ws, not in the tree, so a tree can be shared by
+	 * threads that each use their own workspace.
+	 * The calculation runs on the alignment's compiled form of the tree (see CompiledTree).
+	 */
+	double calcFelsDouble(Alignment & a, int pos5, int pos3, FelsWorkspace & ws) const;
+	double calcFelsSingle(Alignment & a, int pos, FelsWorkspace & ws) const;
+
+	/**
+	 * log (base 2) of the above. Use these: they stay accurate when the likelihood itself
+	 * is too small to be represented as a double (large trees)
+	 */
+	double logFelsDouble(Alignment & a, int pos5, int pos3, FelsWorkspace & ws) const;
+	double logFelsSingle(Alignment & a, int pos, FelsWorkspace & ws) const;
 
 	/*
 	 * returns the length of the branch + the total length of all subtrees
@@ -50,20 +64,28 @@ public:
 
 	double matrix16[16][16];
 	double matrix4[4][4];
-	double fels[16];
+
+	/**
+	 * number of nodes in the subtree rooted at this node (including this node)
+	 */
+	int nodeCount;
 
 	static bool nonGapPair;
 
+	/**
+	 * if true, print a warning when a partial likelihood underflows (default = false)
+	 */
+	static bool underflowWarnings;
+
 private:
+	//not copyable: owns its children
+	Tree(const Tree & other);
+	Tree & operator=(const Tree & other);
 
 	void createChildren(list<string*> & newickStringTokens);
 	void setUpMatrices();
 
-	vector<int> interpretNonPairingGap(vector<int> & nongap);
-
 	static int leafCount;
-	static bool felsDoubleUnderflow;
-	static bool felsSingleUnderflow;
 
 };
 
@@ -111,107 +111,46 @@ int Utilities::lowerBound(vector<double> & v, int begin, int end, double value){
 Utilities::~Utilities() {
 }
 
-vector<int> Utilities::interpret(char cC)
+/*
+ * bit 0 = A, bit 1 = U/T, bit 2 = G, bit 3 = C. IUPAC codes set the bits of every
+ * nucleotide they stand for; N and gaps set all four.
+ */
+const unsigned char Utilities::nucleotideMask[256] = {
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, 15,  0,  0, // '-'
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  1, 14,  8,  7,  0,  0,  4, 11,  0,  0,  6,  0,  9, 15,  0, // '@', 'A' - 'O'
+	 0,  0,  5, 12,  2,  2, 13,  3,  0, 10,  0,  0,  0,  0,  0,  0, // 'P' - 'Z'
+	 0,  1, 14,  8,  7,  0,  0,  4, 11,  0,  0,  6,  0,  9, 15,  0, // '`', 'a' - 'o'
+	 0,  0,  5, 12,  2,  2, 13,  3,  0, 10,  0,  0,  0,  0,  0,  0, // 'p' - 'z'
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0
+};
+
+int Utilities::interpretMask(char cC)
 {
-	vector<int> iTable;
-	for(int i = 0; i < 4; i++){
-		iTable.push_back(0);
-	}
-
-	if(cC == 'a' || cC == 'A'){
-		iTable[0] = 1;
-		iTable[1] = 0;
-		iTable[2] = 0;
-		iTable[3] = 0;
-	}
-	else if(cC == 'u' || cC == 'U' || cC == 't' || cC == 'T'){
-		iTable[0] = 0;
-		iTable[1] = 1;
-		iTable[2] = 0;
-		iTable[3] = 0;
-	}
-	else if(cC == 'g' || cC == 'G'){
-		iTable[0] = 0;
-		iTable[1] = 0;
-		iTable[2] = 1;
-		iTable[3] = 0;
-	}
-	else if(cC == 'c' || cC == 'C'){
-		iTable[0] = 0;
-		iTable[1] = 0;
-		iTable[2] = 0;
-		iTable[3] = 1;
-	}
-	else if(cC == 'b' || cC == 'B'){  /* b = g|c|t */
-		iTable[0] = 0;
-		iTable[1] = 1;
-		iTable[2] = 1;
-		iTable[3] = 1;
-	}
-	else if(cC == 'd' || cC == 'D'){  /* d = g|a|t */
-		iTable[0] = 1;
-		iTable[1] = 1;
-		iTable[2] = 1;
-		iTable[3] = 0;
-	}
-	else if(cC == 'h' || cC == 'H'){  /* h = t|c|a */
-		iTable[0] =1;
-		iTable[1] =1;
-		iTable[2] =0;
-		iTable[3] =1;
-	}
-	else if(cC == 'v' || cC == 'V'){  /* v = g|a|c */
-		iTable[0] = 1;
-		iTable[1] = 0;
-		iTable[2] = 1;
-		iTable[3] = 1;
-	}
-	else if(cC == 'y' || cC == 'Y'){  /* y = t|c */
-		iTable[0] = 0;
-		iTable[1] = 1;
-		iTable[2] = 0;
-		iTable[3] = 1;
-	}
-	else if(cC == 'r' || cC == 'R'){  /* r = a|g */
-		iTable[0] = 1;
-		iTable[1] = 0;
-		iTable[2] = 1;
-		iTable[3] = 0;
-	}
-	else if(cC == 'm' || cC == 'M'){  /* m = a|c */
-		iTable[0] = 1;
-		iTable[1] = 0;
-		iTable[2] = 0;
-		iTable[3] = 1;
-	}
-	else if(cC == 'k' || cC == 'K'){  /* k = g|t */
-		iTable[0] = 0;
-		iTable[1] = 1;
-		iTable[2] = 1;
-		iTable[3] = 0;
-	}
-	else if(cC == 'w' || cC == 'W'){  /* w = a|t */
-		iTable[0] = 1;
-		iTable[1] = 1;
-		iTable[2] = 0;
-		iTable[3] = 0;
-	}
-	else if(cC == 's' || cC == 'S'){  /* s = g|c */
-		iTable[0] = 0;
-		iTable[1] = 0;
-		iTable[2] = 1;
-		iTable[3] = 1;
-	}
-	else if(cC == 'n' || cC == 'N' || cC == '-'){
-		iTable[0] = 1;
-		iTable[1] = 1;
-		iTable[2] = 1;
-		iTable[3] = 1;
-	}
-	else{
+	int mask = nucleotideMask[(unsigned char)cC];
+	if(mask == 0){
 		cerr << "Error: unrecognized sequence character '" << cC <<"'.\n";
 		exit(-1);
 	}
+	return mask;
+}
+
+vector<int> Utilities::interpret(char cC)
+{
+	int mask = interpretMask(cC);
+	vector<int> iTable(4);
+	for(int i = 0; i < 4; i++){
+		iTable[i] = (mask >> i) & 1;
+	}
 	return iTable;
 }
 
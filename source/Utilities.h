@@ -31,6 +31,17 @@ public:
 
 	static vector<int> interpret(char a); //similar to iAt, but allows full set of nucleotide symbols
 
+	/**
+	 * interpret as a 4-bit mask: bit i is set if entry i of interpret(a) is 1.
+	 * Exits with an error if a is not a nucleotide symbol. No allocation.
+	 */
+	static int interpretMask(char a);
+
+	/**
+	 * the mask of every character, 0 if it is not a nucleotide symbol
+	 */
+	static const unsigned char nucleotideMask[256];
+
 	/**
 	 * retrieves the corresponding nucleotide symbol for an integer i
 	 * The order is as in interpret (and different from iAt)
@@ -0,0 +1,115 @@
+/*
+ * Copyright: Nicholas P Wiebe (2008-2009) and Irmtraud M Meyer (2008-2009)
+ * License: licensed under the GNU General Public License version 3 (GPLv3)
+ */
+
+#include "WindowScanner.h"
+#include "Alignment.h"
+#include "HelixFinder.h"
+#include <climits>
+#include <cassert>
+
+WindowScanner::WindowScanner(Tree & tree, int window, int step) : tree(tree), window(window), step(step) {
+	assert(step > 0 && step <= window);
+	names = tree.getSeqNames();
+	windowCount = 0;
+}
+
+WindowScanner::~WindowScanner() {
+}
+
+void WindowScanner::scan(MafReader & reader, int randomSamples, bool doPvalues){
+	vector<string> rows(names.size());
+	long bufferStart = 0; //column of the alignment at which rows start
+	long windowStart = 0;
+	basesBefore.assign(names.size(), '\0');
+	bool more = true;
+	bool done = false;
+
+	while(!done){
+		//read until the window is followed by at least one more column, or the alignment ends
+		//(scanWindow reads on if it needs the base after the window of a species)
+		while(more && bufferStart + (long)rows[0].length() <= windowStart + window){
+			more = reader.readBlock(rows);
+		}
+
+		long end = bufferStart + rows[0].length();
+		if(windowStart >= end){
+			break;
+		}
+		int length = min((long)window, end - windowStart);
+		done = !more && windowStart + length == end;
+
+		scanWindow(reader, more, rows, windowStart - bufferStart, length, windowStart, done, randomSamples, doPvalues);
+
+		//drop the columns before the next window
+		windowStart += step;
+		int dropped = min((long)rows[0].length(), windowStart - bufferStart);
+		for(unsigned int i = 0; i < rows.size(); i++){
+			size_t last = (dropped > 0) ? rows[i].find_last_not_of('-', dropped - 1) : string::npos;
+			if(last != string::npos){
+				basesBefore[i] = rows[i][last];
+			}
+			rows[i].erase(0, dropped);
+		}
+		bufferStart += dropped;
+	}
+}
+
+void WindowScanner::scanWindow(MafReader & reader, bool & more, vector<string> & rows, int offset, int length,
+		long windowStart, bool last, int randomSamples, bool doPvalues){
+	bool first = windowStart == 0;
+
+	vector<string> windowRows(rows.size());
+	for(unsigned int i = 0; i < rows.size(); i++){
+		windowRows[i] = rows[i].substr(offset, length);
+	}
+	vector<int> emptyStruct(length, -1);
+	Alignment alignment(names, windowRows, emptyStruct);
+	windowCount++;
+
+	HelixFinder hf(&alignment);
+	hf.columnOffset = windowStart;
+	hf.basesBefore = basesBefore;
+	//the base after the window of each species. If it has not been read yet, it is only
+	//needed if a stem reaches the end of the window: then read on until it is found
+	hf.basesAfter = vector<char>(rows.size(), '?');
+	for(unsigned int i = 0; i < rows.size(); i++){
+		size_t after = rows[i].find_first_not_of('-', offset + length);
+		if(after == string::npos && more && hf.reachesWindowEnd(i)){
+			do{
+				more = reader.readBlock(rows);
+				after = rows[i].find_first_not_of('-', offset + length);
+			} while(after == string::npos && more);
+		}
+		if(after != string::npos){
+			hf.basesAfter[i] = rows[i][after];
+		}
+		else if(!more){
+			hf.basesAfter[i] = '\0';
+		}
+	}
+	//wider helices do not always lie in the window whose core holds their centre
+	hf.maxColumnSpan = window - step;
+	hf.findAllHelices(HelixFinder::threads);
+
+	//keep the helices centred in the middle step columns of the window
+	long coreStart = first ? LONG_MIN : windowStart + (window - step) / 2;
+	long coreEnd = last ? LONG_MAX : windowStart + (window - step) / 2 + step;
+	vector<AlignedHelix> core;
+	for(unsigned int j = 0; j < hf.helices.size(); j++){
+		long centre = windowStart + (hf.helices[j].bp(0).first + hf.helices[j].bp(0).second) / 2;
+		if(centre >= coreStart && centre < coreEnd){
+			core.push_back(AlignedHelix());
+			core.back().swap(hf.helices[j]);
+		}
+	}
+	hf.helices.swap(core);
+
+	if(!hf.helices.empty()){
+		hf.allHelicesPvalueTable(randomSamples, tree, doPvalues);
+		//one header for the whole table
+		Alignment::printHeaders = false;
+	}
+	HelixFinder::addRescaled(alignment.felsWorkspace);
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright: Nicholas P Wiebe (2008-2009) and Irmtraud M Meyer (2008-2009)
+ * License: licensed under the GNU General Public License version 3 (GPLv3)
+ * WindowScanner.h
+ *
+ * Scans a long (e.g. whole-genome) alignment for helices in overlapping windows.
+ * Alignment blocks are read as they are needed and dropped once all windows that
+ * overlap them are done, so memory depends on the window size, not on the length of
+ * the alignment.
+ *
+ * Consecutive windows overlap by window - step columns. Each window is responsible
+ * for the middle step columns of itself (the first and last windows also for their
+ * outer ends), and only reports the helices whose centre lies there. So every helix
+ * is reported by at most one window. A helix whose outer pair spans at most
+ * window - step columns always lies within the window that is responsible for its
+ * centre, so it is reported by exactly one window. Wider helices may not fit into
+ * that window, and are left out of every window (see HelixFinder::maxColumnSpan), so
+ * that whether a helix is reported does not depend on where the windows start. Stems that
+ * continue past the ends of a window are left out: they are found whole in the
+ * neighbouring window, if they fit into it. To decide whether a stem continues past the
+ * end of a window, the alignment is read ahead until the next base of its species,
+ * however far away (in columns) that is. Only species with a stem that reaches the end
+ * of the window are read ahead for, so long stretches of gaps are only buffered when
+ * they decide whether a helix is reported.
+ */
+
+#ifndef WINDOWSCANNER_H_
+#define WINDOWSCANNER_H_
+
+#include <string>
+#include <vector>
+#include "MafReader.h"
+#include "Tree.h"
+
+using namespace std;
+
+class WindowScanner {
+public:
+	WindowScanner(Tree & tree, int window, int step);
+	virtual ~WindowScanner();
+
+	/**
+	 * finds the helices of every window of the alignment read by reader, and prints their
+	 * pvalue table (see HelixFinder::allHelicesPvalueTable) as each window is done.
+	 * Positions in the table are columns of the whole alignment.
+	 */
+	void scan(MafReader & reader, int randomSamples, bool doPvalues);
+
+	/**
+	 * species of the alignment, i.e. the leaves of the tree
+	 */
+	vector<string> names;
+
+	/**
+	 * number of windows scanned so far
+	 */
+	int windowCount;
+
+private:
+	Tree & tree;
+	int window;
+	int step;
+
+	/**
+	 * for each species, the last base before the current window ('\0' if none)
+	 */
+	vector<char> basesBefore;
+
+	/**
+	 * finds and prints the helices of the window of length columns starting at column
+	 * windowStart of the alignment, which is column offset of rows. last is true if the
+	 * window holds the end of the alignment. Reads more blocks of reader into rows if
+	 * needed (more is false once there are none left)
+	 */
+	void scanWindow(MafReader & reader, bool & more, vector<string> & rows, int offset, int length,
+			long windowStart, bool last, int randomSamples, bool doPvalues);
+};
+
+#endif /* WINDOWSCANNER_H_ */
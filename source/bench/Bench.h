@@ -0,0 +1,92 @@
+/*
+ * Copyright: Nicholas P Wiebe (2008-2009) and Irmtraud M Meyer (2008-2009)
+ * License: licensed under the GNU General Public License version 3 (GPLv3)
+ * Bench.h
+ *
+ * Helpers shared by the benchmark programs (built with "make bench"): a clock, a reader
+ * for the aligned fasta files of the examples, and a random sequence generator. Each
+ * benchmark repeats its work until it has taken at least MIN_SECONDS, and reports the
+ * time of one repetition.
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdlib>
+#include <cctype>
+#include <sys/time.h>
+
+using namespace std;
+
+namespace Bench {
+
+static const double MIN_SECONDS = 0.5;
+
+/**
+ * wall clock time in seconds
+ */
+inline double seconds(){
+	timeval now;
+	gettimeofday(&now, NULL);
+	return now.tv_sec + now.tv_usec / 1e6;
+}
+
+/**
+ * names and rows of an aligned fasta file, in upper case. The structure line (the last
+ * entry of the example files, holding brackets) is left out
+ */
+inline void readFasta(const string & filename, vector<string> & names, vector<string> & rows){
+	ifstream in(filename.c_str());
+	if(!in){
+		cerr << "Error: could not open " << filename << endl;
+		exit(-1);
+	}
+	string line;
+	while(getline(in, line)){
+		if(!line.empty() && line[line.length() - 1] == '\r'){
+			line.erase(line.length() - 1);
+		}
+		if(line.empty()){
+			continue;
+		}
+		if(line[0] == '>'){
+			names.push_back(line.substr(1));
+			rows.push_back("");
+		}
+		else if(!rows.empty()){
+			for(unsigned int i = 0; i < line.length(); i++){
+				rows.back() += toupper(line[i]);
+			}
+		}
+	}
+	if(!rows.empty() && rows.back().find_first_of("().<>[]") != string::npos){
+		names.pop_back();
+		rows.pop_back();
+	}
+}
+
+/**
+ * random RNA sequence of the given length, with G and U each making up guFraction / 2
+ * of it (0.5 for uniform bases)
+ */
+inline string randomSequence(int length, double guFraction, unsigned int & state){
+	string seq(length, 'A');
+	for(int i = 0; i < length; i++){
+		double r = rand_r(&state) / (RAND_MAX + 1.0);
+		if(r < guFraction){
+			seq[i] = (r < guFraction / 2) ? 'G' : 'U';
+		}
+		else{
+			seq[i] = (r < (1 + guFraction) / 2) ? 'A' : 'C';
+		}
+	}
+	return seq;
+}
+
+}
+
+#endif /* BENCH_H_ */
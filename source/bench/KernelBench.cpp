@@ -0,0 +1,210 @@
+/*
+ * Copyright: Nicholas P Wiebe (2008-2009) and Irmtraud M Meyer (2008-2009)
+ * License: licensed under the GNU General Public License version 3 (GPLv3)
+ * KernelBench.cpp
+ *
+ * Times each product kernel of CompiledTree (see FelsKernel) that this processor supports,
+ * and checks that it gives bit-for-bit the same results as the scalar kernel. Two inputs:
+ *  - the products alone, on a fixed set of NODES pseudo-random transition matrices and
+ *    partial likelihoods (the same every run)
+ *  - logFelsDouble and logFelsSingle for every column pair and column of an alignment
+ *
+ * usage: KernelBench [fasta tree]
+ * Without inputs, the RF00168 example is used.
+ */
+
+#include "Bench.h"
+#include "../CompiledTree.h"
+#include "../FelsWorkspace.h"
+#include "../Alignment.h"
+#include "../Tree.h"
+#include <cstdio>
+#include <cstring>
+
+static const int NODES = 64;
+
+static const FelsKernel KERNELS[] = {SCALAR_KERNEL, SSE2_KERNEL, AVX2_KERNEL};
+static const int KERNEL_COUNT = 3;
+
+/**
+ * 64-byte aligned array of count doubles, as CompiledTree keeps its matrices
+ */
+static double * alignedDoubles(int count){
+	void * memory = NULL;
+	if(posix_memalign(&memory, 64, count * sizeof(double)) != 0){
+		cerr << "Error: could not allocate " << count << " doubles\n";
+		exit(-1);
+	}
+	return (double *)memory;
+}
+
+/**
+ * NODES row major n x n matrices with rows summing to 1, and NODES vectors of n
+ * partial likelihoods in (0, 1]
+ */
+static void fixedInput(int n, vector<double> & matrices, vector<double> & fels){
+	unsigned int state = 1;
+	matrices.resize(NODES * n * n);
+	fels.resize(NODES * n);
+	for(int m = 0; m < NODES; m++){
+		for(int i = 0; i < n; i++){
+			double * row = &matrices[(m * n + i) * n];
+			double sum = 0;
+			for(int j = 0; j < n; j++){
+				row[j] = (rand_r(&state) + 1.0) / (RAND_MAX + 1.0);
+				sum += row[j];
+			}
+			for(int j = 0; j < n; j++){
+				row[j] /= sum;
+			}
+		}
+		for(int i = 0; i < n; i++){
+			fels[m * n + i] = (rand_r(&state) + 1.0) / (RAND_MAX + 1.0);
+		}
+	}
+}
+
+/**
+ * products per second of product on the n x n input, with the results in out
+ * (NODES * n doubles): node m multiplies matrix and likelihoods m with those of m + 1
+ */
+static double timeProducts(ProductKernel product, int n, bool columnMajor,
+		const vector<double> & matrices, const vector<double> & fels, double * out){
+	double * kernelMatrices = alignedDoubles(matrices.size());
+	double * kernelFels = alignedDoubles(fels.size());
+	for(int m = 0; m < NODES; m++){
+		for(int i = 0; i < n; i++){
+			for(int j = 0; j < n; j++){
+				kernelMatrices[m * n * n + (columnMajor ? n * j + i : n * i + j)] = matrices[m * n * n + n * i + j];
+			}
+		}
+	}
+	memcpy(kernelFels, &fels[0], fels.size() * sizeof(double));
+
+	long products = 0;
+	double start = Bench::seconds();
+	double elapsed;
+	do{
+		for(int m = 0; m < NODES; m++){
+			int sibling = (m + 1) % NODES;
+			product(&kernelMatrices[m * n * n], &kernelFels[m * n],
+					&kernelMatrices[sibling * n * n], &kernelFels[sibling * n], &out[m * n]);
+		}
+		products += NODES;
+		elapsed = Bench::seconds() - start;
+	} while(elapsed < Bench::MIN_SECONDS);
+
+	free(kernelMatrices);
+	free(kernelFels);
+	return products / elapsed;
+}
+
+static void benchProducts(){
+	vector<double> matrices16, fels16, matrices4, fels4;
+	fixedInput(16, matrices16, fels16);
+	fixedInput(4, matrices4, fels4);
+	//two n x n matrix-vector products (a multiply and an add per entry), then n multiplies
+	const double flops16 = 2 * 2 * 16 * 16 + 16;
+	const double flops4 = 2 * 2 * 4 * 4 + 4;
+
+	double * scalar16 = alignedDoubles(NODES * 16);
+	double * scalar4 = alignedDoubles(NODES * 4);
+	double * out16 = alignedDoubles(NODES * 16);
+	double * out4 = alignedDoubles(NODES * 4);
+
+	printf("products on %d fixed nodes\n", NODES);
+	printf("%-8s %14s %9s %10s %14s %9s %10s\n", "kernel", "16x16 Mprod/s", "GFLOP/s", "identical",
+			"4x4 Mprod/s", "GFLOP/s", "identical");
+	for(int k = 0; k < KERNEL_COUNT; k++){
+		if(CompiledTree::supportedKernel(KERNELS[k]) != KERNELS[k]){
+			printf("%-8s not supported\n", CompiledTree::kernelName(KERNELS[k]));
+			continue;
+		}
+		ProductKernel product16, product4;
+		bool columnMajor;
+		CompiledTree::productKernels(KERNELS[k], product16, product4, columnMajor);
+		double * results16 = (KERNELS[k] == SCALAR_KERNEL) ? scalar16 : out16;
+		double * results4 = (KERNELS[k] == SCALAR_KERNEL) ? scalar4 : out4;
+		double rate16 = timeProducts(product16, 16, columnMajor, matrices16, fels16, results16);
+		double rate4 = timeProducts(product4, 4, columnMajor, matrices4, fels4, results4);
+		bool same16 = memcmp(results16, scalar16, NODES * 16 * sizeof(double)) == 0;
+		bool same4 = memcmp(results4, scalar4, NODES * 4 * sizeof(double)) == 0;
+		printf("%-8s %14.2f %9.2f %10s %14.2f %9.2f %10s\n", CompiledTree::kernelName(KERNELS[k]),
+				rate16 / 1e6, rate16 * flops16 / 1e9, same16 ? "yes" : "NO",
+				rate4 / 1e6, rate4 * flops4 / 1e9, same4 ? "yes" : "NO");
+	}
+
+	free(scalar16);
+	free(scalar4);
+	free(out16);
+	free(out4);
+}
+
+/**
+ * milliseconds for the log likelihoods of every column pair and column of a, with the
+ * results in likelihoods
+ */
+static double timeLikelihoods(const CompiledTree & ct, Alignment & a, vector<double> & likelihoods){
+	int columns = a.alignedSeqs[0]->length();
+	FelsWorkspace ws;
+	int repetitions = 0;
+	double start = Bench::seconds();
+	double elapsed;
+	do{
+		likelihoods.clear();
+		for(int i = 0; i < columns; i++){
+			for(int j = i + 1; j < columns; j++){
+				likelihoods.push_back(ct.logFelsDouble(a, i, j, ws));
+			}
+			likelihoods.push_back(ct.logFelsSingle(a, i, ws));
+		}
+		repetitions++;
+		elapsed = Bench::seconds() - start;
+	} while(elapsed < Bench::MIN_SECONDS);
+	return 1000 * elapsed / repetitions;
+}
+
+static void benchLikelihoods(string & fasta, string & treeFile){
+	Alignment a(fasta);
+	Tree root(treeFile);
+	int columns = a.alignedSeqs[0]->length();
+	long pairs = (long)columns * (columns - 1) / 2;
+
+	printf("\nlikelihoods of %ld column pairs and %d columns of %s (%d sequences)\n", pairs, columns,
+			fasta.substr(fasta.find_last_of('/') + 1).c_str(), (int)a.alignedSeqs.size());
+	printf("%-8s %10s %14s %10s\n", "kernel", "ms", "Mpairs/s", "identical");
+	vector<double> scalarLikelihoods;
+	for(int k = 0; k < KERNEL_COUNT; k++){
+		if(CompiledTree::supportedKernel(KERNELS[k]) != KERNELS[k]){
+			continue;
+		}
+		CompiledTree::kernel = KERNELS[k];
+		CompiledTree ct(root, a.seqNames);
+		vector<double> likelihoods;
+		double ms = timeLikelihoods(ct, a, likelihoods);
+		if(KERNELS[k] == SCALAR_KERNEL){
+			scalarLikelihoods = likelihoods;
+		}
+		bool same = likelihoods.size() == scalarLikelihoods.size()
+				&& memcmp(&likelihoods[0], &scalarLikelihoods[0], likelihoods.size() * sizeof(double)) == 0;
+		printf("%-8s %10.3f %14.3f %10s\n", CompiledTree::kernelName(KERNELS[k]), ms,
+				pairs / ms / 1e3, same ? "yes" : "NO");
+	}
+}
+
+int main(int argc, char** argv){
+	string fasta = "../../examples/RF00168.fasta_al";
+	string treeFile = "../../examples/RF00168.fixtree";
+	if(argc == 3){
+		fasta = argv[1];
+		treeFile = argv[2];
+	}
+	else if(argc != 1){
+		cerr << "usage: KernelBench [fasta tree]\n";
+		return -1;
+	}
+
+	benchProducts();
+	benchLikelihoods(fasta, treeFile);
+	return 0;
+}
@@ -0,0 +1,273 @@
+/*
+ * Copyright: Nicholas P Wiebe (2008-2009) and Irmtraud M Meyer (2008-2009)
+ * License: licensed under the GNU General Public License version 3 (GPLv3)
+ * LeafBench.cpp
+ *
+ * Times the leaf partial likelihoods of CompiledTree (copies of tip vectors precomputed
+ * from Utilities::nucleotideMask) against the code they replaced, which built them from
+ * the vector<int> of Utilities::interpret for every leaf. Every column pair (resp. column)
+ * of every sequence of an alignment is one leaf, and both give the same partials.
+ *
+ * usage: LeafBench [fasta files]
+ * Without inputs, the example alignments are used.
+ */
+
+#include "Bench.h"
+#include "../CompiledTree.h"
+#include "../Tree.h"
+#include <cstdio>
+#include <cstring>
+
+/**
+ * Utilities::interpret before nucleotideMask: a chain of comparisons, and a new vector
+ */
+__attribute__((noinline))
+static vector<int> oldInterpret(char cC){
+	vector<int> iTable;
+	for(int i = 0; i < 4; i++){
+		iTable.push_back(0);
+	}
+
+	if(cC == 'a' || cC == 'A'){
+		iTable[0] = 1;
+	}
+	else if(cC == 'u' || cC == 'U' || cC == 't' || cC == 'T'){
+		iTable[1] = 1;
+	}
+	else if(cC == 'g' || cC == 'G'){
+		iTable[2] = 1;
+	}
+	else if(cC == 'c' || cC == 'C'){
+		iTable[3] = 1;
+	}
+	else if(cC == 'b' || cC == 'B'){  /* b = g|c|t */
+		iTable[1] = iTable[2] = iTable[3] = 1;
+	}
+	else if(cC == 'd' || cC == 'D'){  /* d = g|a|t */
+		iTable[0] = iTable[1] = iTable[2] = 1;
+	}
+	else if(cC == 'h' || cC == 'H'){  /* h = t|c|a */
+		iTable[0] = iTable[1] = iTable[3] = 1;
+	}
+	else if(cC == 'v' || cC == 'V'){  /* v = g|a|c */
+		iTable[0] = iTable[2] = iTable[3] = 1;
+	}
+	else if(cC == 'y' || cC == 'Y'){  /* y = t|c */
+		iTable[1] = iTable[3] = 1;
+	}
+	else if(cC == 'r' || cC == 'R'){  /* r = a|g */
+		iTable[0] = iTable[2] = 1;
+	}
+	else if(cC == 'm' || cC == 'M'){  /* m = a|c */
+		iTable[0] = iTable[3] = 1;
+	}
+	else if(cC == 'k' || cC == 'K'){  /* k = g|t */
+		iTable[1] = iTable[2] = 1;
+	}
+	else if(cC == 'w' || cC == 'W'){  /* w = a|t */
+		iTable[0] = iTable[1] = 1;
+	}
+	else if(cC == 's' || cC == 'S'){  /* s = g|c */
+		iTable[2] = iTable[3] = 1;
+	}
+	else if(cC == 'n' || cC == 'N' || cC == '-'){
+		iTable[0] = iTable[1] = iTable[2] = iTable[3] = 1;
+	}
+	else{
+		cerr << "Error: unrecognized sequence character '" << cC <<"'.\n";
+		exit(-1);
+	}
+	return iTable;
+}
+
+/**
+ * CompiledTree::interpretNonPairingGap before nucleotideMask
+ */
+static vector<int> oldInterpretNonPairingGap(vector<int> & nongap){
+	vector<int> iTable;
+	for(int i = 0; i < 4; i++){
+		iTable.push_back(1);
+	}
+	if(nongap[0] == 1){
+		//A
+		iTable[1] = 0;
+	}
+	if(nongap[1] == 1){
+		//U
+		iTable[0] = 0;
+		iTable[2] = 0;
+	}
+	if(nongap[2] == 1){
+		//G
+		iTable[1] = 0;
+		iTable[3] = 0;
+	}
+	if(nongap[3] == 1){
+		//C
+		iTable[2] = 0;
+	}
+	return iTable;
+}
+
+/**
+ * CompiledTree::pairedLeaf before nucleotideMask
+ */
+__attribute__((noinline))
+static void oldPairedLeaf(char base5, char base3, double * fels){
+	//convert Ns to gaps:
+	if (base5 == 'N' || base5 == 'n'){
+		base5 = '-';
+	}
+	if (base3 == 'N' || base3 == 'n'){
+		base3 = '-';
+	}
+
+	vector<int> leftInterpreted, rightInterpreted;
+
+	if(Tree::nonGapPair && base5 == '-' && base3 != '-'){
+		rightInterpreted = oldInterpret(base3);
+		leftInterpreted = oldInterpretNonPairingGap(rightInterpreted);
+	}
+	else if(Tree::nonGapPair && base3 == '-' && base5 != '-'){
+		leftInterpreted = oldInterpret(base5);
+		rightInterpreted = oldInterpretNonPairingGap(leftInterpreted);
+	}
+	else{
+		leftInterpreted = oldInterpret(base5);
+		rightInterpreted = oldInterpret(base3);
+	}
+
+	for(int i = 0; i < 4; i++){
+		for(int j = 0; j < 4; j++){
+			fels[4 * i + j] = leftInterpreted[i] * rightInterpreted[j];
+		}
+	}
+}
+
+/**
+ * the single leaf of CompiledTree::scaledFelsSingle before nucleotideMask
+ */
+__attribute__((noinline))
+static void oldSingleLeaf(char base, double * fels){
+	vector<int> interpreted = oldInterpret(base);
+	for(int i = 0; i < 4; i++){
+		fels[i] = interpreted[i];
+	}
+}
+
+/**
+ * nanoseconds per leaf to fill the paired (or, if !paired, single) leaves of all of rows,
+ * with the old code or the tables
+ */
+static double timeLeaves(const vector<string> & rows, bool paired, bool old, long & leaves){
+	int columns = rows[0].length();
+	double fels[16];
+	double sum = 0;
+	long repetitions = 0;
+	double start = Bench::seconds();
+	double elapsed;
+	do{
+		leaves = 0;
+		for(unsigned int s = 0; s < rows.size(); s++){
+			const string & row = rows[s];
+			for(int i = 0; i < columns; i++){
+				if(!paired){
+					if(old){
+						oldSingleLeaf(row[i], fels);
+					}
+					else{
+						CompiledTree::singleLeaf(row[i], fels);
+					}
+					sum += fels[0];
+					leaves++;
+					continue;
+				}
+				for(int j = i + 1; j < columns; j++){
+					if(old){
+						oldPairedLeaf(row[i], row[j], fels);
+					}
+					else{
+						CompiledTree::pairedLeaf(row[i], row[j], fels);
+					}
+					sum += fels[5];
+				}
+				leaves += columns - i - 1;
+			}
+		}
+		repetitions++;
+		elapsed = Bench::seconds() - start;
+	} while(elapsed < Bench::MIN_SECONDS);
+	//keeps the leaves from being optimized away
+	if(sum < 0){
+		printf("%f\n", sum);
+	}
+	return 1e9 * elapsed / (repetitions * leaves);
+}
+
+/**
+ * true if the old code and the tables give the same partials for every leaf of rows
+ */
+static bool sameLeaves(const vector<string> & rows, bool paired){
+	int columns = rows[0].length();
+	double oldFels[16], newFels[16];
+	for(unsigned int s = 0; s < rows.size(); s++){
+		const string & row = rows[s];
+		for(int i = 0; i < columns; i++){
+			if(!paired){
+				oldSingleLeaf(row[i], oldFels);
+				CompiledTree::singleLeaf(row[i], newFels);
+				if(memcmp(oldFels, newFels, 4 * sizeof(double)) != 0){
+					return false;
+				}
+				continue;
+			}
+			for(int j = i + 1; j < columns; j++){
+				oldPairedLeaf(row[i], row[j], oldFels);
+				CompiledTree::pairedLeaf(row[i], row[j], newFels);
+				if(memcmp(oldFels, newFels, 16 * sizeof(double)) != 0){
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+static void run(const string & label, const vector<string> & rows, bool paired){
+	long leaves;
+	double oldTime = timeLeaves(rows, paired, true, leaves);
+	double newTime = timeLeaves(rows, paired, false, leaves);
+	printf("%-28s %-18s %11ld %9.2f %9.2f %8.1fx  %s\n", label.c_str(),
+			paired ? (Tree::nonGapPair ? "paired" : "paired -nonGapPair") : "single", leaves,
+			oldTime, newTime, oldTime / newTime, sameLeaves(rows, paired) ? "yes" : "NO");
+}
+
+int main(int argc, char** argv){
+	vector<string> files;
+	for(int i = 1; i < argc; i++){
+		if(argv[i][0] == '-'){
+			cerr << "usage: LeafBench [fasta files]\n";
+			return -1;
+		}
+		files.push_back(argv[i]);
+	}
+	if(files.empty()){
+		files.push_back("../../examples/RF00168.fasta_al");
+		files.push_back("../../examples/E_coli_RNaseP_high.fasta_al");
+	}
+
+	printf("ns per leaf\n");
+	printf("%-28s %-18s %11s %9s %9s %9s  %s\n", "input", "leaves", "count", "before", "after", "speedup",
+			"identical");
+	for(unsigned int f = 0; f < files.size(); f++){
+		vector<string> names, rows;
+		Bench::readFasta(files[f], names, rows);
+		string label = files[f].substr(files[f].find_last_of('/') + 1);
+		run(label, rows, false);
+		Tree::nonGapPair = true;
+		run(label, rows, true);
+		Tree::nonGapPair = false;
+		run(label, rows, true);
+	}
+	return 0;
+}
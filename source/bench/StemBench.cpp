@@ -0,0 +1,199 @@
+/*
+ * Copyright: Nicholas P Wiebe (2008-2009) and Irmtraud M Meyer (2008-2009)
+ * License: licensed under the GNU General Public License version 3 (GPLv3)
+ * StemBench.cpp
+ *
+ * Times the stem searches of StemFinder against the loop they replaced (one canPair
+ * test per pair along each anti-diagonal), and checks that all three find the same stems.
+ *
+ * usage: StemBench [-minSL n] [-maxSpan n] [-random length count guFraction] [fasta files]
+ * Without inputs, the sequences of the example alignments are used, followed by random
+ * sequences of 2000, 8000 and 32000 bases (uniform and G/U rich).
+ */
+
+#include "Bench.h"
+#include "../StemFinder.h"
+#include "../Alignment.h"
+#include <cstdio>
+#include <climits>
+
+/**
+ * the anti-diagonal loop of HelixFinder::findAllHelices before StemFinder: maximal stems
+ * longer than minStemLength, in the order of StemFinder::findStems
+ */
+static void oldLoopStems(const string & Seq, int minStemLength, vector<Helix> & stems, int maxSpan){
+	int iL = Seq.length();
+	for(int s = MIN_DIST; s <= 2 * iL - 3; s++){
+		int run = 0;
+		int i = (s - MIN_DIST) / 2;
+		int j = s - i;
+		for(; i >= 0 && j < iL && j - i <= maxSpan; i--, j++){
+			if(StemFinder::canPair(Seq[i], Seq[j])){
+				run++;
+			}
+			else{
+				if(run > minStemLength){
+					stems.push_back(Helix(i+1, j-1, run));
+				}
+				run = 0;
+			}
+		}
+
+		if(run > minStemLength){
+			stems.push_back(Helix(i+1, j-1, run));
+		}
+	}
+}
+
+enum Search { OLD_LOOP, EXHAUSTIVE, SEEDED };
+
+static void search(Search method, const string & seq, int minStemLength, vector<Helix> & stems, int maxSpan){
+	if(method == OLD_LOOP){
+		oldLoopStems(seq, minStemLength, stems, maxSpan);
+	}
+	else{
+		//a new StemFinder each time, as for every sequence of an alignment
+		StemFinder finder(seq);
+		if(method == EXHAUSTIVE){
+			finder.findStemsExhaustive(minStemLength, stems, maxSpan);
+		}
+		else{
+			finder.findStemsSeeded(minStemLength, stems, maxSpan);
+		}
+	}
+}
+
+/**
+ * milliseconds to search all of seqs with method, and the stems found
+ */
+static double timeSearch(Search method, const vector<string> & seqs, int minStemLength, int maxSpan,
+		vector<vector<Helix> > & stems){
+	int repetitions = 0;
+	double start = Bench::seconds();
+	double elapsed;
+	do{
+		for(unsigned int i = 0; i < seqs.size(); i++){
+			stems[i].clear();
+			search(method, seqs[i], minStemLength, stems[i], maxSpan);
+		}
+		repetitions++;
+		elapsed = Bench::seconds() - start;
+	} while(elapsed < Bench::MIN_SECONDS);
+	return 1000 * elapsed / repetitions;
+}
+
+static bool sameStems(const vector<vector<Helix> > & a, const vector<vector<Helix> > & b){
+	for(unsigned int i = 0; i < a.size(); i++){
+		if(a[i].size() != b[i].size()){
+			return false;
+		}
+		for(unsigned int j = 0; j < a[i].size(); j++){
+			if(a[i][j].pos5 != b[i][j].pos5 || a[i][j].pos3 != b[i][j].pos3 || a[i][j].length != b[i][j].length){
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static void run(const string & label, const vector<string> & seqs, int minStemLength, int maxSpan){
+	vector<vector<Helix> > oldStems(seqs.size()), exhaustiveStems(seqs.size()), seededStems(seqs.size());
+	double oldTime = timeSearch(OLD_LOOP, seqs, minStemLength, maxSpan, oldStems);
+	double exhaustiveTime = timeSearch(EXHAUSTIVE, seqs, minStemLength, maxSpan, exhaustiveStems);
+	double seededTime = timeSearch(SEEDED, seqs, minStemLength, maxSpan, seededStems);
+
+	long bases = 0;
+	long stems = 0;
+	for(unsigned int i = 0; i < seqs.size(); i++){
+		bases += seqs[i].length();
+		stems += oldStems[i].size();
+	}
+	bool identical = sameStems(oldStems, exhaustiveStems) && sameStems(oldStems, seededStems);
+	printf("%-28s %6d %9ld %10.3f %10.3f %10.3f %9ld  %s\n", label.c_str(), (int)seqs.size(), bases,
+			oldTime, exhaustiveTime, seededTime, stems, identical ? "yes" : "NO");
+}
+
+int main(int argc, char** argv){
+	int minStemLength = 3;
+	int maxSpan = INT_MAX;
+	vector<string> files;
+	vector<int> randomLengths, randomCounts;
+	vector<double> randomGu;
+
+	for(int i = 1; i < argc; i++){
+		string arg = argv[i];
+		if(arg.compare("-minSL") == 0 && i + 1 < argc){
+			minStemLength = atoi(argv[++i]);
+		}
+		else if(arg.compare("-maxSpan") == 0 && i + 1 < argc){
+			maxSpan = atoi(argv[++i]);
+		}
+		else if(arg.compare("-random") == 0 && i + 3 < argc){
+			randomLengths.push_back(atoi(argv[++i]));
+			randomCounts.push_back(atoi(argv[++i]));
+			randomGu.push_back(atof(argv[++i]));
+		}
+		else if(arg[0] != '-'){
+			files.push_back(arg);
+		}
+		else{
+			cerr << "usage: StemBench [-minSL n] [-maxSpan n] [-random length count guFraction] [fasta files]\n";
+			return -1;
+		}
+	}
+	if(files.empty() && randomLengths.empty()){
+		files.push_back("../../examples/RF00168.fasta_al");
+		files.push_back("../../examples/E_coli_RNaseP_high.fasta_al");
+		int lengths[] = {2000, 8000, 32000};
+		int counts[] = {20, 4, 1};
+		for(int k = 0; k < 3; k++){
+			randomLengths.push_back(lengths[k]);
+			randomCounts.push_back(counts[k]);
+			randomGu.push_back(0.5);
+			randomLengths.push_back(lengths[k]);
+			randomCounts.push_back(counts[k]);
+			randomGu.push_back(0.9);
+		}
+	}
+
+	if(maxSpan == INT_MAX){
+		printf("minSL %d, no maxSpan; times in ms for all sequences of an input\n", minStemLength);
+	}
+	else{
+		printf("minSL %d, maxSpan %d; times in ms for all sequences of an input\n", minStemLength, maxSpan);
+	}
+	printf("%-28s %6s %9s %10s %10s %10s %9s  %s\n", "input", "seqs", "bases", "old loop", "exhaustive", "seeded",
+			"stems", "identical");
+
+	for(unsigned int f = 0; f < files.size(); f++){
+		vector<string> names, rows;
+		Bench::readFasta(files[f], names, rows);
+		//the ungapped sequences, as searched by Alignment::sequenceStems
+		vector<string> seqs;
+		for(unsigned int i = 0; i < rows.size(); i++){
+			string seq;
+			for(unsigned int j = 0; j < rows[i].length(); j++){
+				char base = rows[i][j];
+				if(base != '-' && base != '.'){
+					seq += (base == 'T') ? 'U' : base;
+				}
+			}
+			seqs.push_back(seq);
+		}
+		string label = files[f].substr(files[f].find_last_of('/') + 1);
+		run(label, seqs, minStemLength, maxSpan);
+	}
+
+	unsigned int state = 1;
+	for(unsigned int r = 0; r < randomLengths.size(); r++){
+		vector<string> seqs;
+		for(int i = 0; i < randomCounts[r]; i++){
+			seqs.push_back(Bench::randomSequence(randomLengths[r], randomGu[r], state));
+		}
+		char label[64];
+		sprintf(label, "random L=%d GU=%.2f", randomLengths[r], randomGu[r]);
+		run(label, seqs, minStemLength, maxSpan);
+	}
+
+	return 0;
+}